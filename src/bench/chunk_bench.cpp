@@ -0,0 +1,128 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+#include "../client/block_registry.hpp"
+#include "../client/chunk_mesh.hpp"
+#include "../client/chunk_neighborhood.hpp"
+#include "../client/lighting.hpp"
+#include "../client/world_data.hpp"
+#include "../client/world_generator.hpp"
+
+// Meshing and lighting throughput for the voxel layout this binary was built with. Configure once per
+// VV_CHUNK_LAYOUT value and compare the numbers.
+
+#if defined(VV_CHUNK_LAYOUT_MORTON)
+static constexpr auto sc_layout_name = "morton";
+#elif defined(VV_CHUNK_LAYOUT_TILED)
+static constexpr auto sc_layout_name = "tiled";
+#else
+static constexpr auto sc_layout_name = "linear";
+#endif
+
+static constexpr int sc_radius = 4;
+static constexpr int sc_iterations = 5;
+
+template <typename Callable>
+static double time_ms(Callable callable)
+{
+    const auto begin = std::chrono::steady_clock::now();
+    std::invoke(callable);
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+static void report(const char* stage, const size_t sections, const double ms)
+{
+    std::printf(
+        "%-10s %10.2f ms %12.0f sections/s\n", stage, ms, static_cast<double>(sections) / (ms / 1000.0));
+}
+
+int main()
+{
+    // RES_PATH is relative, load before leaving the working directory
+    load_block_registry(std::filesystem::absolute(res_path("blocks.json")));
+
+    // The world saves itself on destruction and saves depend on the layout, keep it away from the game's saves
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "voxelverse_chunk_bench";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::filesystem::current_path(dir);
+
+    WorldData world_data;
+    const WorldGenerator generator(1);
+    // One extra ring so every measured section has loaded neighbours
+    for_2d({ -sc_radius - 1, -sc_radius - 1 }, { sc_radius + 2, sc_radius + 2 }, [&](const nnm::Vector2i pos) {
+        world_data.create_or_load_chunk(pos);
+    });
+    for_2d({ -sc_radius - 1, -sc_radius - 1 }, { sc_radius + 2, sc_radius + 2 }, [&](const nnm::Vector2i pos) {
+        generator.generate_chunk(world_data, pos);
+    });
+
+    std::vector<nnm::Vector2i> columns;
+    std::vector<nnm::Vector3i> sections;
+    for_2d({ -sc_radius, -sc_radius }, { sc_radius + 1, sc_radius + 1 }, [&](const nnm::Vector2i pos) {
+        columns.push_back(pos);
+        world_data.chunk_column_data_at(pos).for_each_chunk_data(
+            [&](const ChunkData& chunk) { sections.push_back(chunk.position()); });
+    });
+    std::printf("layout %s, %zu sections, %d iterations\n", sc_layout_name, sections.size(), sc_iterations);
+
+    uint64_t checksum = 0;
+
+    // Six-neighbour reads through ChunkData, the access pattern of the meshing and lighting loops
+    const double sweep_ms = time_ms([&] {
+        for (int i = 0; i < sc_iterations; ++i) {
+            for (const nnm::Vector3i chunk_pos : sections) {
+                const ChunkData& chunk = world_data.chunk_data_at(chunk_pos);
+                for_3d({ 1, 1, 1 }, { 15, 15, 15 }, [&](const nnm::Vector3i pos) {
+                    for (int f = 0; f < 6; ++f) {
+                        checksum += chunk.get_block(pos + direction_vector(static_cast<Direction>(f)));
+                    }
+                });
+            }
+        }
+    });
+    report("sweep", sections.size() * sc_iterations, sweep_ms);
+
+    const double lighting_ms = time_ms([&] {
+        for (int i = 0; i < sc_iterations; ++i) {
+            for (const nnm::Vector3i chunk_pos : sections) {
+                world_data.chunk_data_at(chunk_pos).reset_lighting();
+            }
+            for (const nnm::Vector2i pos : columns) {
+                apply_sunlight(world_data.chunk_column_data_at(pos));
+            }
+            for (const nnm::Vector3i chunk_pos : sections) {
+                propagate_light(world_data, chunk_pos);
+            }
+        }
+    });
+    report("lighting", sections.size() * sc_iterations, lighting_ms);
+
+    std::vector<ChunkNeighborhood> neighborhoods(sections.size());
+    const double snapshot_ms = time_ms([&] {
+        for (int i = 0; i < sc_iterations; ++i) {
+            for (size_t s = 0; s < sections.size(); ++s) {
+                world_data.copy_neighborhood(sections[s], neighborhoods[s]);
+            }
+        }
+    });
+    report("snapshot", sections.size() * sc_iterations, snapshot_ms);
+
+    const double meshing_ms = time_ms([&] {
+        for (int i = 0; i < sc_iterations; ++i) {
+            for (const ChunkNeighborhood& neighborhood : neighborhoods) {
+                if (const std::optional<ChunkBufferData> data = create_chunk_buffer_data(neighborhood);
+                    data.has_value()) {
+                    checksum += data->index_data.size();
+                }
+            }
+        }
+    });
+    report("meshing", sections.size() * sc_iterations, meshing_ms);
+
+    std::printf("checksum %llu\n", static_cast<unsigned long long>(checksum));
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../client/block_registry.hpp"
+#include "../client/column_codec.hpp"
+#include "../client/column_store.hpp"
+#include "../client/save_file.hpp"
+#include "../client/section_pool.hpp"
+#include "../client/world_data.hpp"
+#include "../client/world_generator.hpp"
+
+// Save throughput of each storage backend on generated columns, covering the game's patterns: saving a batch of
+// columns, saving the same columns again after editing one section and after editing all of them, loading columns one
+// at a time and loading a region at once, then recompressing them all as the save writer does with cold columns and
+// loading them again. Given the directory of an existing save, such as save/world_data, it measures that save's columns
+// instead, since generated terrain has none of the edits, builds and open sky of a played world.
+
+static constexpr int sc_radius = 12;
+// How far from the origin columns of an existing save are read
+static constexpr int sc_save_radius = 2048;
+static constexpr int sc_rewrites = 4;
+static constexpr int sc_random_reads = 4;
+
+template <typename Callable>
+static double time_ms(Callable callable)
+{
+    const auto begin = std::chrono::steady_clock::now();
+    std::invoke(callable);
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+static std::vector<int> section_heights(const ChunkColumn& column)
+{
+    std::vector<int> heights;
+    column.for_each_chunk_data([&](const ChunkData& chunk) { heights.push_back(chunk.position().z); });
+    return heights;
+}
+
+static void report(const char* stage, const size_t columns, const double ms)
+{
+    std::printf("%-11s %10.2f ms %12.0f columns/s\n", stage, ms, static_cast<double>(columns) / (ms / 1000.0));
+}
+
+static uintmax_t directory_size(const std::filesystem::path& path)
+{
+    uintmax_t size = 0;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(path)) {
+        if (entry.is_regular_file()) {
+            size += entry.file_size();
+        }
+    }
+    return size;
+}
+
+static void bench_backend(
+    const char* backend_name,
+    const SaveBackendType backend,
+    const std::vector<ChunkColumn>& columns,
+    const nnm::Vector2i min,
+    const nnm::Vector2i max)
+{
+    std::printf("backend %s\n", backend_name);
+    const std::string name = std::string("bench_") + backend_name;
+    uint64_t checksum = 0;
+    ChunkColumn column({ 0, 0 });
+    {
+        SaveFile save(16 * 1024 * 1024, name, backend);
+
+        const double write_ms = time_ms([&] {
+            save.begin_batch();
+            for (const ChunkColumn& saved : columns) {
+                save_column(save, saved, section_heights(saved));
+            }
+            save.submit_batch();
+        });
+        report("write", columns.size(), write_ms);
+
+        // Columns are saved again every time they are edited and unloaded, one write at a time. An edit usually
+        // touches a single section, which is all that is written.
+        const double rewrite_ms = time_ms([&] {
+            for (int r = 0; r < sc_rewrites; ++r) {
+                for (const ChunkColumn& saved : columns) {
+                    const std::vector<int> heights = section_heights(saved);
+                    // Columns of open sky from an existing save have no sections to edit
+                    if (heights.empty()) {
+                        continue;
+                    }
+                    save_column(save, saved, { heights[r % heights.size()] });
+                }
+            }
+        });
+        report("rewrite", columns.size() * sc_rewrites, rewrite_ms);
+        const double rewrite_whole_ms = time_ms([&] {
+            for (int r = 0; r < sc_rewrites; ++r) {
+                for (const ChunkColumn& saved : columns) {
+                    save_column(save, saved, section_heights(saved));
+                }
+            }
+        });
+        report("rewrite all", columns.size() * sc_rewrites, rewrite_whole_ms);
+
+        std::vector<size_t> order(columns.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), std::mt19937(1));
+        std::vector<int> unsaved_heights;
+        const auto read_all = [&] {
+            for (int r = 0; r < sc_random_reads; ++r) {
+                for (const size_t i : order) {
+                    column = ChunkColumn(columns[i].pos());
+                    VV_REL_ASSERT(
+                        load_column(save, columns[i].pos(), column, unsaved_heights), "[save_bench] Missing column")
+                    checksum += column.memory_usage();
+                }
+            }
+        };
+        report("read", columns.size() * sc_random_reads, time_ms(read_all));
+
+        SectionPool section_pool;
+        BS::thread_pool thread_pool;
+        const double region_ms = time_ms([&] {
+            load_columns(
+                save,
+                min,
+                max,
+                section_pool,
+                thread_pool,
+                [](nnm::Vector2i) { return true; },
+                [&](const ChunkColumn& loaded, const std::vector<int>&) { checksum += loaded.memory_usage(); });
+        });
+        report("region", columns.size(), region_ms);
+
+        const double recompress_ms = time_ms([&] {
+            for (const ChunkColumn& saved : columns) {
+                recompress_column(save, saved.pos());
+            }
+        });
+        report("recompress", columns.size(), recompress_ms);
+        report("read hc", columns.size() * sc_random_reads, time_ms(read_all));
+    }
+
+    // Includes opening the save, closing it above synced it to disk
+    const double reopen_ms = time_ms([&] {
+        SaveFile save(16 * 1024 * 1024, name, backend);
+        std::vector<int> unsaved_heights;
+        for (const ChunkColumn& saved : columns) {
+            column = ChunkColumn(saved.pos());
+            VV_REL_ASSERT(
+                load_column(save, saved.pos(), column, unsaved_heights), "[save_bench] Missing column after reopen")
+            checksum += column.memory_usage();
+        }
+    });
+    report("reopen", columns.size(), reopen_ms);
+
+    const std::string path = backend == SaveBackendType::region ? "save/" + name + "_regions" : "save/" + name;
+    std::printf(
+        "disk %.2f MiB, checksum %llu\n",
+        static_cast<double>(directory_size(path)) / (1024.0 * 1024.0),
+        static_cast<unsigned long long>(checksum));
+}
+
+static std::vector<ChunkColumn> generate_columns()
+{
+    std::vector<ChunkColumn> columns;
+    WorldData world_data;
+    const WorldGenerator generator(1);
+    // One extra ring so trees and light reach every measured column
+    for_2d({ -sc_radius - 1, -sc_radius - 1 }, { sc_radius + 2, sc_radius + 2 }, [&](const nnm::Vector2i pos) {
+        world_data.create_or_load_chunk(pos);
+    });
+    for_2d({ -sc_radius - 1, -sc_radius - 1 }, { sc_radius + 2, sc_radius + 2 }, [&](const nnm::Vector2i pos) {
+        generator.generate_chunk(world_data, pos);
+    });
+    // Copied out unpooled, the world's pool goes away with it
+    for_2d({ -sc_radius, -sc_radius }, { sc_radius + 1, sc_radius + 1 }, [&](const nnm::Vector2i pos) {
+        decode_column(encode_column(world_data.chunk_column_data_at(pos)), columns.emplace_back(pos));
+    });
+    return columns;
+}
+
+// Reads a copy, opening a save can write to it
+static std::vector<ChunkColumn> load_saved_columns(const std::filesystem::path& path)
+{
+    VV_REL_ASSERT(std::filesystem::is_directory(path), "[save_bench] Save directory not found")
+    // LevelDB keeps a CURRENT file, region saves do not
+    const SaveBackendType backend
+        = std::filesystem::exists(path / "CURRENT") ? SaveBackendType::leveldb : SaveBackendType::region;
+    std::filesystem::copy(
+        path,
+        backend == SaveBackendType::region ? "save/source_regions" : "save/source",
+        std::filesystem::copy_options::recursive);
+
+    std::vector<ChunkColumn> columns;
+    SaveFile save(16 * 1024 * 1024, "source", backend);
+    save.migrate_legacy_column_keys();
+    SectionPool section_pool;
+    BS::thread_pool thread_pool;
+    load_columns(
+        save,
+        { -sc_save_radius, -sc_save_radius },
+        { sc_save_radius, sc_save_radius },
+        section_pool,
+        thread_pool,
+        [](nnm::Vector2i) { return true; },
+        [&](const ChunkColumn& loaded, const std::vector<int>&) {
+            // Copied out unpooled like generated columns
+            decode_column(encode_column(loaded), columns.emplace_back(loaded.pos()));
+        });
+    VV_REL_ASSERT(!columns.empty(), "[save_bench] Save has no columns")
+    std::filesystem::remove_all("save");
+    return columns;
+}
+
+int main(const int argc, char* argv[])
+{
+    // RES_PATH is relative, load before leaving the working directory
+    load_block_registry(std::filesystem::absolute(res_path("blocks.json")));
+    const std::optional<std::filesystem::path> save_path
+        = argc > 1 ? std::optional(std::filesystem::absolute(argv[1])) : std::nullopt;
+
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "voxelverse_save_bench";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "save");
+    std::filesystem::current_path(dir);
+
+    const std::vector<ChunkColumn> columns
+        = save_path.has_value() ? load_saved_columns(*save_path) : generate_columns();
+    nnm::Vector2i min = columns.front().pos();
+    nnm::Vector2i max = columns.front().pos();
+    size_t total_size = 0;
+    size_t section_size = 0;
+    size_t section_count = 0;
+    for (const ChunkColumn& column : columns) {
+        min = { std::min(min.x, column.pos().x), std::min(min.y, column.pos().y) };
+        max = { std::max(max.x, column.pos().x), std::max(max.y, column.pos().y) };
+        total_size += encode_column(column).size();
+        column.for_each_chunk_data([&](const ChunkData& chunk) {
+            section_size += encode_section(chunk).size();
+            section_count++;
+        });
+    }
+    std::printf(
+        "%zu columns, %.2f MiB encoded, %.1f KiB per column, %.1f KiB per section\n",
+        columns.size(),
+        static_cast<double>(total_size) / (1024.0 * 1024.0),
+        static_cast<double>(total_size) / 1024.0 / static_cast<double>(columns.size()),
+        static_cast<double>(section_size) / 1024.0 / static_cast<double>(std::max<size_t>(section_count, 1)));
+
+    bench_backend("leveldb", SaveBackendType::leveldb, columns, min, max);
+    bench_backend("region", SaveBackendType::region, columns, min, max);
+    return 0;
+}
\ No newline at end of file
@@ -43,7 +43,9 @@ App::App()
 
     std::invoke(resize_func, m_window.size());
 
-    auto [fullscreen, msaa] = load_options();
+    auto [fullscreen, msaa, memory_budget_mb, cache_budget_mb] = load_options();
+    m_world.set_memory_budget_mb(memory_budget_mb);
+    m_world.set_cache_budget_mb(cache_budget_mb);
     if (fullscreen) {
         m_window.fullscreen(true);
     }
@@ -127,7 +129,10 @@ void App::main_loop()
         m_current_frame_count++;
     }
 
-    const Options options { .fullscreen = m_window.is_fullscreen(), .msaa = m_renderer.current_msaa_samples() };
+    const Options options { .fullscreen = m_window.is_fullscreen(),
+                            .msaa = m_renderer.current_msaa_samples(),
+                            .memory_budget_mb = m_world.memory_budget_mb(),
+                            .cache_budget_mb = m_world.cache_budget_mb() };
     set_options(options);
 }
 
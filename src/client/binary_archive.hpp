@@ -0,0 +1,189 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <cereal/details/helpers.hpp>
+
+#include "cow_vector.hpp"
+
+#include "../common/assert.hpp"
+
+// Archives for the serialize, save and load functions written for cereal that copy straight between values and a byte
+// buffer, without streams. The bytes match cereal's PortableBinary archives with their default little endian
+// options, so data written by either can be read by the other. Only the types the chunk classes are made of are
+// supported: arithmetic and enum values, arrays and vectors of them, size tags and classes describing themselves.
+
+static_assert(std::endian::native == std::endian::little, "Binary archives copy values without swapping bytes");
+
+class BinaryOutputArchive {
+public:
+    using is_loading = std::false_type;
+    using is_saving = std::true_type;
+
+    // Appends to the buffer, starting with the endianness flag cereal writes
+    explicit BinaryOutputArchive(std::vector<char>& buffer)
+        : m_buffer(&buffer)
+    {
+        write(uint8_t { 1 });
+    }
+
+    template <typename... Args>
+    void operator()(const Args&... args)
+    {
+        (write(args), ...);
+    }
+
+    void write_bytes(const void* data, const size_t size)
+    {
+        const size_t offset = m_buffer->size();
+        m_buffer->resize(offset + size);
+        std::memcpy(m_buffer->data() + offset, data, size);
+    }
+
+private:
+    template <typename T>
+        requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+    void write(const T value)
+    {
+        write_bytes(&value, sizeof(T));
+    }
+
+    template <typename T, size_t N>
+    void write(const std::array<T, N>& values)
+    {
+        write_bytes(values.data(), sizeof(T) * N);
+    }
+
+    template <typename T>
+    void write(const std::vector<T>& values)
+    {
+        write(static_cast<uint64_t>(values.size()));
+        write_bytes(values.data(), sizeof(T) * values.size());
+    }
+
+    template <typename T>
+    void write(const cereal::SizeTag<T>& tag)
+    {
+        write(static_cast<uint64_t>(tag.size));
+    }
+
+    template <typename T>
+        requires requires(const T& value, BinaryOutputArchive& archive) { value.save(archive); }
+    void write(const T& value)
+    {
+        value.save(*this);
+    }
+
+    // cereal's serialize functions take the value mutably for both directions
+    template <typename T>
+        requires requires(T& value, BinaryOutputArchive& archive) { value.serialize(archive); }
+    void write(const T& value)
+    {
+        const_cast<T&>(value).serialize(*this);
+    }
+
+    template <typename T>
+        requires requires(T& value, BinaryOutputArchive& archive) { serialize(archive, value); }
+    void write(const T& value)
+    {
+        serialize(*this, const_cast<T&>(value));
+    }
+
+    std::vector<char>* m_buffer;
+};
+
+class BinaryInputArchive {
+public:
+    using is_loading = std::true_type;
+    using is_saving = std::false_type;
+
+    explicit BinaryInputArchive(const std::string_view data)
+        : m_data(data)
+    {
+        uint8_t little_endian;
+        read(little_endian);
+        VV_REL_ASSERT(little_endian == 1, "[BinaryInputArchive] Big endian data")
+    }
+
+    template <typename... Args>
+    void operator()(Args&&... args)
+    {
+        (read(args), ...);
+    }
+
+    void read_bytes(void* data, const size_t size)
+    {
+        VV_REL_ASSERT(size <= m_data.size(), "[BinaryInputArchive] Read past the end of the data")
+        std::memcpy(data, m_data.data(), size);
+        m_data.remove_prefix(size);
+    }
+
+    // What has not been read yet
+    [[nodiscard]] std::string_view remaining() const
+    {
+        return m_data;
+    }
+
+private:
+    template <typename T>
+        requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+    void read(T& value)
+    {
+        read_bytes(&value, sizeof(T));
+    }
+
+    template <typename T, size_t N>
+    void read(std::array<T, N>& values)
+    {
+        read_bytes(values.data(), sizeof(T) * N);
+    }
+
+    template <typename T>
+    void read(std::vector<T>& values)
+    {
+        uint64_t size;
+        read(size);
+        // Checked before resizing so corrupt sizes throw instead of allocating
+        VV_REL_ASSERT(size <= m_data.size() / sizeof(T), "[BinaryInputArchive] Read past the end of the data")
+        values.resize(size);
+        read_bytes(values.data(), sizeof(T) * size);
+    }
+
+    template <typename T>
+    void read(cereal::SizeTag<T>& tag)
+    {
+        uint64_t size;
+        read(size);
+        tag.size = static_cast<std::remove_reference_t<T>>(size);
+    }
+
+    template <typename T>
+        requires requires(T& value, BinaryInputArchive& archive) { value.load(archive); }
+    void read(T& value)
+    {
+        value.load(*this);
+    }
+
+    template <typename T>
+        requires requires(T& value, BinaryInputArchive& archive) { value.serialize(archive); }
+    void read(T& value)
+    {
+        value.serialize(*this);
+    }
+
+    template <typename T>
+        requires requires(T& value, BinaryInputArchive& archive) { serialize(archive, value); }
+    void read(T& value)
+    {
+        serialize(*this, value);
+    }
+
+    std::string_view m_data;
+};
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "block_accessor.hpp"
+
+#include <algorithm>
+
+#include "chunk_column.hpp"
+
+BlockAccessor::BlockAccessor(const WorldData& world_data)
+    : m_world_data(&world_data)
+{
+}
+
+BlockAccessor::BlockAccessor(const WorldData& world_data, const nnm::Vector2i min, const nnm::Vector2i max)
+    : m_world_data(&world_data)
+    , m_lock_min(min)
+    , m_lock_max(max)
+{
+    m_lock.emplace(world_data, min, max, WorldData::LockMode::read);
+}
+
+std::optional<uint8_t> BlockAccessor::block_at(const nnm::Vector3i block_pos)
+{
+    // Arithmetic shifts and masks are floored division and modulo by 16 for negative positions too
+    if (!seek({ block_pos.x >> 4, block_pos.y >> 4, block_pos.z >> 4 })) {
+        return {};
+    }
+    if (m_section == nullptr) {
+        return 0;
+    }
+    return m_section->get_block({ block_pos.x & 15, block_pos.y & 15, block_pos.z & 15 });
+}
+
+BlockRange BlockAccessor::block_range(const BoundingBox& box)
+{
+    // Blocks are unit cubes centered on their position
+    const auto min = nnm::Vector3i(box.min.round());
+    const nnm::Vector3i max = nnm::Vector3i(box.max.round()) + nnm::Vector3i(1, 1, 1);
+    return { min, { std::max(min.x, max.x), std::max(min.y, max.y), std::max(min.z, max.z) } };
+}
+
+void BlockAccessor::read_blocks(const BlockRange& range, const std::span<uint8_t> blocks)
+{
+    VV_DEB_ASSERT(blocks.size() >= volume(range), "[BlockAccessor] Span is smaller than the range")
+    const nnm::Vector3i size = range.max - range.min;
+    if (size.x <= 0 || size.y <= 0 || size.z <= 0) {
+        return;
+    }
+    const nnm::Vector3i chunk_min { range.min.x >> 4, range.min.y >> 4, range.min.z >> 4 };
+    const nnm::Vector3i chunk_max { (range.max.x - 1) >> 4, (range.max.y - 1) >> 4, (range.max.z - 1) >> 4 };
+    std::optional<WorldData::ColumnLock> lock;
+    if (!m_lock.has_value()) {
+        lock.emplace(
+            *m_world_data,
+            nnm::Vector2i(chunk_min.x, chunk_min.y),
+            nnm::Vector2i(chunk_max.x, chunk_max.y),
+            WorldData::LockMode::read);
+        // Columns seen before the lock may have been removed since
+        m_has_column = false;
+    }
+    for_3d(chunk_min, chunk_max + nnm::Vector3i(1, 1, 1), [&](const nnm::Vector3i chunk_pos) {
+        // Part of the range inside this section, in world positions
+        const nnm::Vector3i from { std::max(range.min.x, chunk_pos.x * 16),
+                                   std::max(range.min.y, chunk_pos.y * 16),
+                                   std::max(range.min.z, chunk_pos.z * 16) };
+        const nnm::Vector3i to { std::min(range.max.x, chunk_pos.x * 16 + 16),
+                                 std::min(range.max.y, chunk_pos.y * 16 + 16),
+                                 std::min(range.max.z, chunk_pos.z * 16 + 16) };
+        const ChunkData* section = seek(chunk_pos) ? m_section : nullptr;
+        for (int z = from.z; z < to.z; ++z) {
+            for (int y = from.y; y < to.y; ++y) {
+                const size_t row = (static_cast<size_t>(z - range.min.z) * size.y + (y - range.min.y)) * size.x;
+                uint8_t* out = blocks.data() + row + (from.x - range.min.x);
+                if (section == nullptr) {
+                    std::fill_n(out, to.x - from.x, uint8_t { 0 });
+                    continue;
+                }
+                for (int x = from.x; x < to.x; ++x) {
+                    *out++ = section->get_block({ x & 15, y & 15, z & 15 });
+                }
+            }
+        }
+    });
+}
+
+bool BlockAccessor::seek(const nnm::Vector3i chunk_pos)
+{
+    VV_DEB_ASSERT(
+        !m_lock.has_value()
+            || (chunk_pos.x >= m_lock_min.x && chunk_pos.y >= m_lock_min.y && chunk_pos.x <= m_lock_max.x
+                && chunk_pos.y <= m_lock_max.y),
+        "[BlockAccessor] Column outside of the locked ones")
+    if (!m_has_column || chunk_pos.x != m_column_pos.x || chunk_pos.y != m_column_pos.y) {
+        m_column = m_world_data->find_column({ chunk_pos.x, chunk_pos.y });
+        m_column_pos = { chunk_pos.x, chunk_pos.y };
+        m_has_column = true;
+        m_section = m_column == nullptr ? nullptr : m_column->find_chunk_data(chunk_pos.z);
+        m_section_height = chunk_pos.z;
+    }
+    else if (chunk_pos.z != m_section_height) {
+        m_section = m_column == nullptr ? nullptr : m_column->find_chunk_data(chunk_pos.z);
+        m_section_height = chunk_pos.z;
+    }
+    return m_column != nullptr;
+}
\ No newline at end of file
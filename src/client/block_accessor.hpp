@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include "common.hpp"
+
+#include <nnm/nnm.hpp>
+
+#include "world_data.hpp"
+
+class ChunkColumn;
+class ChunkData;
+
+// Block positions from min up to but not including max, the same bounds for_3d takes
+struct BlockRange {
+    nnm::Vector3i min;
+    nnm::Vector3i max;
+};
+
+// Reads blocks from WorldData while remembering the column and section of the previous read, so runs of nearby
+// reads skip the column lookup and section search. It holds pointers into the world: use one for a batch of reads
+// and drop it before columns are created, culled or written. The main thread writes, so it can read through one
+// without locks. Other threads construct it over the columns they read, which holds lock_columns for reading until it
+// is dropped, or only use read_blocks, which locks the columns it gathers for the call.
+class BlockAccessor {
+public:
+    explicit BlockAccessor(const WorldData& world_data);
+
+    // Reads columns from min to max inclusive only, keeping them locked for reading while it lives. The main thread
+    // must not write to them meanwhile.
+    BlockAccessor(const WorldData& world_data, nnm::Vector2i min, nnm::Vector2i max);
+
+    BlockAccessor(const BlockAccessor&) = delete;
+
+    BlockAccessor& operator=(const BlockAccessor&) = delete;
+
+    // Empty for unloaded columns
+    [[nodiscard]] std::optional<uint8_t> block_at(nnm::Vector3i block_pos);
+
+    // Blocks whose unit cubes overlap the box
+    [[nodiscard]] static BlockRange block_range(const BoundingBox& box);
+
+    [[nodiscard]] static size_t volume(const BlockRange& range)
+    {
+        const nnm::Vector3i size = range.max - range.min;
+        return static_cast<size_t>(size.x) * size.y * size.z;
+    }
+
+    // Fills x fastest, then y, then z, one section at a time. Unloaded columns read as air. Locks the columns for
+    // reading unless the accessor holds a lock over them already.
+    void read_blocks(const BlockRange& range, std::span<uint8_t> blocks);
+
+    void read_blocks(const BoundingBox& box, const std::span<uint8_t> blocks)
+    {
+        read_blocks(block_range(box), blocks);
+    }
+
+private:
+    // False if the column is not loaded, otherwise m_section is the section or null when it is open sky
+    bool seek(nnm::Vector3i chunk_pos);
+
+    const WorldData* m_world_data;
+    std::optional<WorldData::ColumnLock> m_lock {};
+    nnm::Vector2i m_lock_min {};
+    nnm::Vector2i m_lock_max {};
+    bool m_has_column = false;
+    nnm::Vector2i m_column_pos {};
+    const ChunkColumn* m_column = nullptr;
+    int m_section_height = 0;
+    const ChunkData* m_section = nullptr;
+};
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "block_registry.hpp"
+
+#include <fstream>
+
+#include <nlohmann/json.hpp>
+
+#include "../common/assert.hpp"
+
+using json = nlohmann::json;
+
+BlockTables g_block_tables = [] {
+    // Until a registry is loaded only air is known
+    BlockTables tables;
+    tables.transparent[0] = true;
+    return tables;
+}();
+
+static nnm::Vector2i parse_tile(const json& tile)
+{
+    VV_REL_ASSERT(
+        tile.is_array() && tile.size() == 2 && tile[0].is_number_integer() && tile[1].is_number_integer(),
+        "[BlockRegistry] Tiles must be [x, y] arrays")
+    return { tile[0].get<int>(), tile[1].get<int>() };
+}
+
+void load_block_registry(const std::filesystem::path& path)
+{
+    std::ifstream file(path);
+    VV_REL_ASSERT(file.is_open(), "[BlockRegistry] Unable to open " + path.string())
+    const json data = json::parse(file, nullptr, false);
+    VV_REL_ASSERT(!data.is_discarded(), "[BlockRegistry] Invalid JSON in " + path.string())
+    VV_REL_ASSERT(data.contains("blocks") && data["blocks"].is_array(), "[BlockRegistry] Missing blocks array")
+
+    BlockTables tables;
+    tables.transparent[0] = true;
+    if (data.contains("atlas_size")) {
+        tables.atlas_size = parse_tile(data["atlas_size"]);
+    }
+    for (const json& block : data["blocks"]) {
+        VV_REL_ASSERT(
+            block.contains("id") && block["id"].is_number_integer() && block["id"].get<int>() >= 0
+                && block["id"].get<int>() < 256,
+            "[BlockRegistry] Block ids must be integers from 0 to 255")
+        const int id = block["id"].get<int>();
+        tables.transparent[id] = block.value("transparent", false);
+        const int emission = block.value("emission", 0);
+        VV_REL_ASSERT(emission >= 0 && emission <= 15, "[BlockRegistry] Emission must be from 0 to 15")
+        tables.emission[id] = static_cast<uint8_t>(emission);
+        // "tile" covers every face, "side", "top" and "bottom" override it
+        const nnm::Vector2i tile = block.contains("tile") ? parse_tile(block["tile"]) : nnm::Vector2i(0, 0);
+        const nnm::Vector2i side = block.contains("side") ? parse_tile(block["side"]) : tile;
+        for (const Direction face : { Direction::front, Direction::back, Direction::left, Direction::right }) {
+            tables.face_tiles[static_cast<size_t>(face)][id] = side;
+        }
+        tables.face_tiles[static_cast<size_t>(Direction::top)][id]
+            = block.contains("top") ? parse_tile(block["top"]) : tile;
+        tables.face_tiles[static_cast<size_t>(Direction::bottom)][id]
+            = block.contains("bottom") ? parse_tile(block["bottom"]) : tile;
+    }
+    g_block_tables = tables;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+
+#include "common.hpp"
+
+#include <nnm/nnm.hpp>
+
+// Block properties compiled from res/blocks.json into flat tables indexed by block type, so the meshing and lighting
+// loops do a single load per query
+struct BlockTables {
+    nnm::Vector2i atlas_size { 1, 1 };
+    std::array<bool, 256> transparent {};
+    std::array<uint8_t, 256> emission {};
+    // Indexed by face first so all types for one face are contiguous
+    std::array<std::array<nnm::Vector2i, 256>, 6> face_tiles {};
+};
+
+extern BlockTables g_block_tables;
+
+// Replaces the tables, throws if the file is missing or malformed
+void load_block_registry(const std::filesystem::path& path);
+
+inline nnm::Vector2i block_atlas_size()
+{
+    return g_block_tables.atlas_size;
+}
+
+inline nnm::Vector2i block_uv(const uint8_t block_type, const Direction face)
+{
+    return g_block_tables.face_tiles[static_cast<size_t>(face)][block_type];
+}
+
+inline bool is_transparent(const uint8_t block_type)
+{
+    return g_block_tables.transparent[block_type];
+}
+
+inline uint8_t block_emission(const uint8_t block_type)
+{
+    return g_block_tables.emission[block_type];
+}
\ No newline at end of file
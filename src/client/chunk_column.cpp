@@ -0,0 +1,72 @@
+#include "chunk_column.hpp"
+
+#include "section_pool.hpp"
+
+ChunkColumn& ChunkColumn::operator=(ChunkColumn&& other) noexcept
+{
+    if (this != &other) {
+        release_chunks();
+        m_gen_level = other.m_gen_level;
+        m_pos = other.m_pos;
+        m_min_height = other.m_min_height;
+        m_chunks = std::move(other.m_chunks);
+        other.m_chunks.clear();
+        m_pool = other.m_pool;
+    }
+    return *this;
+}
+
+ChunkColumn::~ChunkColumn()
+{
+    release_chunks();
+}
+
+ChunkColumn ChunkColumn::snapshot() const
+{
+    ChunkColumn snapshot(m_pos);
+    snapshot.m_gen_level = m_gen_level;
+    snapshot.m_min_height = m_min_height;
+    snapshot.m_chunks.reserve(m_chunks.size());
+    for (const std::unique_ptr<ChunkData>& chunk : m_chunks) {
+        snapshot.m_chunks.push_back(chunk == nullptr ? nullptr : std::make_unique<ChunkData>(chunk->snapshot()));
+    }
+    return snapshot;
+}
+
+ChunkData& ChunkColumn::chunk_data_at(const int height)
+{
+    if (m_chunks.empty()) {
+        m_min_height = height;
+    }
+    if (height < m_min_height) {
+        std::vector<std::unique_ptr<ChunkData>> chunks(max_height() - height);
+        std::ranges::move(m_chunks, chunks.begin() + (m_min_height - height));
+        m_chunks = std::move(chunks);
+        m_min_height = height;
+    }
+    else if (height >= max_height()) {
+        m_chunks.resize(height - m_min_height + 1);
+    }
+    std::unique_ptr<ChunkData>& chunk = m_chunks[height - m_min_height];
+    if (chunk == nullptr) {
+        chunk = new_chunk_data(height);
+        chunk->reset_lighting(sky_light_value(LightChannel::sky), sky_light_value(LightChannel::block));
+    }
+    return *chunk;
+}
+
+std::unique_ptr<ChunkData> ChunkColumn::new_chunk_data(const int height) const
+{
+    const nnm::Vector3i chunk_pos { m_pos.x, m_pos.y, height };
+    return m_pool == nullptr ? std::make_unique<ChunkData>(chunk_pos) : m_pool->acquire(chunk_pos);
+}
+
+void ChunkColumn::release_chunks()
+{
+    if (m_pool != nullptr) {
+        for (std::unique_ptr<ChunkData>& chunk : m_chunks) {
+            m_pool->release(std::move(chunk));
+        }
+    }
+    m_chunks.clear();
+}
\ No newline at end of file
@@ -1,9 +1,14 @@
 #pragma once
 
-#include <array>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
 
 // ReSharper disable once CppUnusedIncludeDirective
-#include <cereal/types/array.hpp>
+#include <cereal/types/memory.hpp>
+// ReSharper disable once CppUnusedIncludeDirective
+#include <cereal/types/vector.hpp>
 
 #include "common.hpp"
 
@@ -11,6 +16,18 @@
 
 #include "chunk_data.hpp"
 
+class SectionPool;
+
+// How the sections of a column were saved, filled in when loading it
+struct SavedLayout {
+    // Sections saved on their own, lowest first, allocated empty until loaded
+    std::vector<int> heights_apart;
+    // Saved by an older version with the light of every voxel, sections saved apart included
+    bool lit = false;
+};
+
+// Sections are only allocated where something has been written. A missing section is open sky: air with full
+// skylight and no blocklight.
 class ChunkColumn {
 public:
     enum GenLevel { none, terrain, trees, generated };
@@ -22,54 +39,224 @@ public:
     {
     }
 
+    // Sections come from the pool and go back to it when the column is destroyed, the pool has to outlive it
+    ChunkColumn(const nnm::Vector2i chunk_pos, SectionPool& pool)
+        : m_pos(chunk_pos)
+        , m_pool(&pool)
+    {
+    }
+
+    ChunkColumn(ChunkColumn&& other) noexcept = default;
+
+    ChunkColumn& operator=(ChunkColumn&& other) noexcept;
+
+    ~ChunkColumn();
+
+    // Sections go back to the pool from now on, for columns built away from the thread that owns the pool
+    void set_pool(SectionPool& pool)
+    {
+        m_pool = &pool;
+    }
+
+    // Unpooled column sharing the storage of this one's sections until they are next written, see
+    // ChunkData::snapshot
+    [[nodiscard]] ChunkColumn snapshot() const;
+
     [[nodiscard]] uint8_t get_block(const nnm::Vector3i block_pos) const
     {
-        const nnm::Vector3i chunk_pos = chunk_pos_from_block_pos(block_pos);
-        VV_DEB_ASSERT(chunk_pos.z >= -10 && chunk_pos.z < 10, "[ChunkColumn] Invalid block position");
-        return m_chunks[chunk_pos.z + 10].get_block(block_world_to_local(block_pos));
+        const ChunkData* chunk = find_chunk_data(chunk_height_from_block_height(block_pos.z));
+        return chunk == nullptr ? 0 : chunk->get_block(block_world_to_local(block_pos));
+    }
+
+    void set_light(const nnm::Vector3i block_pos, const LightChannel channel, const uint8_t val)
+    {
+        const int height = chunk_height_from_block_height(block_pos.z);
+        if (find_chunk_data(height) == nullptr && val == sky_light_value(channel)) {
+            return;
+        }
+        chunk_data_at(height).set_light(block_world_to_local(block_pos), channel, val);
     }
 
-    void set_lighting(const nnm::Vector3i block_pos, const uint8_t val)
+    [[nodiscard]] uint8_t light_at(const nnm::Vector3i block_pos, const LightChannel channel) const
     {
-        const nnm::Vector3i chunk_pos = chunk_pos_from_block_pos(block_pos);
-        VV_DEB_ASSERT(chunk_pos.z >= -10 && chunk_pos.z < 10, "[ChunkColumn] Invalid block position");
-        m_chunks[chunk_pos.z + 10].set_lighting(block_world_to_local(block_pos), val);
+        const ChunkData* chunk = find_chunk_data(chunk_height_from_block_height(block_pos.z));
+        return chunk == nullptr ? sky_light_value(channel) : chunk->light_at(block_world_to_local(block_pos), channel);
     }
 
     [[nodiscard]] uint8_t lighting_at(const nnm::Vector3i block_pos) const
     {
-        const nnm::Vector3i chunk_pos = chunk_pos_from_block_pos(block_pos);
-        VV_DEB_ASSERT(chunk_pos.z >= -10 && chunk_pos.z < 10, "[ChunkColumn] Invalid block position");
-        return m_chunks[chunk_pos.z + 10].lighting_at(block_world_to_local(block_pos));
+        const ChunkData* chunk = find_chunk_data(chunk_height_from_block_height(block_pos.z));
+        return chunk == nullptr ? 15 : chunk->lighting_at(block_world_to_local(block_pos));
     }
 
     void set_block(const nnm::Vector3i block_pos, const uint8_t type)
     {
-        const nnm::Vector3i chunk_pos = chunk_pos_from_block_pos(block_pos);
-        VV_DEB_ASSERT(chunk_pos.z >= -10 && chunk_pos.z < 10, "[ChunkColumn] Invalid block position");
-        m_chunks[chunk_pos.z + 10].set_block(block_world_to_local(block_pos), type);
+        const int height = chunk_height_from_block_height(block_pos.z);
+        if (find_chunk_data(height) == nullptr && type == 0) {
+            return;
+        }
+        chunk_data_at(height).set_block(block_world_to_local(block_pos), type);
+    }
+
+    [[nodiscard]] bool contains_chunk_data(const int height) const
+    {
+        return find_chunk_data(height) != nullptr;
+    }
+
+    [[nodiscard]] const ChunkData* find_chunk_data(const int height) const
+    {
+        const int i = height - m_min_height;
+        if (i < 0 || i >= static_cast<int>(m_chunks.size())) {
+            return nullptr;
+        }
+        return m_chunks[i].get();
+    }
+
+    ChunkData* find_chunk_data(const int height)
+    {
+        return const_cast<ChunkData*>(std::as_const(*this).find_chunk_data(height));
     }
 
     [[nodiscard]] const ChunkData& chunk_data_at(const nnm::Vector3i chunk_pos) const
     {
         VV_DEB_ASSERT(
-            chunk_pos.x == m_pos.x && chunk_pos.y == m_pos.y && chunk_pos.z >= -10 && chunk_pos.z < 10,
+            chunk_pos.x == m_pos.x && chunk_pos.y == m_pos.y && contains_chunk_data(chunk_pos.z),
             "[ChunkColumn] Invalid chunk position");
-        return m_chunks[chunk_pos.z + 10];
+        return *find_chunk_data(chunk_pos.z);
     }
 
+    // Allocates the section as open sky if it does not exist yet
     ChunkData& chunk_data_at(const nnm::Vector3i chunk_pos)
     {
-        VV_DEB_ASSERT(
-            chunk_pos.x == m_pos.x && chunk_pos.y == m_pos.y && chunk_pos.z >= -10 && chunk_pos.z < 10,
-            "[ChunkColumn] Invalid chunk position");
-        return m_chunks[chunk_pos.z + 10];
+        VV_DEB_ASSERT(chunk_pos.x == m_pos.x && chunk_pos.y == m_pos.y, "[ChunkColumn] Invalid chunk position");
+        return chunk_data_at(chunk_pos.z);
+    }
+
+    ChunkData& chunk_data_at(int height);
+
+    // Lowest allocated section height, only meaningful when the column has sections
+    [[nodiscard]] int min_height() const
+    {
+        return m_min_height;
+    }
+
+    // One past the highest allocated section height
+    [[nodiscard]] int max_height() const
+    {
+        return m_min_height + static_cast<int>(m_chunks.size());
+    }
+
+    template <typename Callable>
+    void for_each_chunk_data(Callable callable)
+    {
+        for (const std::unique_ptr<ChunkData>& chunk : m_chunks) {
+            if (chunk != nullptr) {
+                std::invoke(callable, *chunk);
+            }
+        }
+    }
+
+    template <typename Callable>
+    void for_each_chunk_data(Callable callable) const
+    {
+        for (const std::unique_ptr<ChunkData>& chunk : m_chunks) {
+            if (chunk != nullptr) {
+                std::invoke(callable, std::as_const(*chunk));
+            }
+        }
+    }
+
+    // Changes whenever any section or the generation level changes
+    [[nodiscard]] uint64_t version() const
+    {
+        uint64_t version = m_gen_level;
+        for_each_chunk_data([&](const ChunkData& chunk) { version += chunk.version(); });
+        return version;
+    }
+
+    [[nodiscard]] size_t memory_usage() const
+    {
+        size_t bytes = sizeof(ChunkColumn) + m_chunks.capacity() * sizeof(std::unique_ptr<ChunkData>);
+        for_each_chunk_data([&](const ChunkData& chunk) { bytes += chunk.memory_usage(); });
+        return bytes;
+    }
+
+    void compact()
+    {
+        for_each_chunk_data([](ChunkData& chunk) { chunk.compact(); });
+    }
+
+    // Laid out like cereal's vector of unique_ptr, which older versions wrote. Sections keep all their light, so
+    // the column needs no relighting when loaded again. Loading fills pooled sections in place.
+    template <class Archive>
+    void save(Archive& archive) const
+    {
+        archive(m_pos, m_min_height, cereal::make_size_tag(static_cast<cereal::size_type>(m_chunks.size())));
+        for (const std::unique_ptr<ChunkData>& chunk : m_chunks) {
+            if (chunk == nullptr) {
+                archive(sc_section_missing);
+            }
+            else {
+                archive(sc_section_inline);
+                chunk->save_lit(archive);
+                archive(chunk->has_spread_light());
+            }
+        }
+        archive(m_gen_level);
     }
 
+    // Like save, with the sections left out to be saved on their own without their sunlight
     template <class Archive>
-    void serialize(Archive& archive)
+    void save_header(Archive& archive) const
     {
-        archive(m_pos, m_chunks, m_gen_level);
+        archive(m_pos, m_min_height, cereal::make_size_tag(static_cast<cereal::size_type>(m_chunks.size())));
+        for (const std::unique_ptr<ChunkData>& chunk : m_chunks) {
+            archive(chunk == nullptr ? sc_section_missing : sc_section_apart);
+        }
+        archive(m_gen_level);
+    }
+
+    template <class Archive>
+    void load(Archive& archive)
+    {
+        load(archive, nullptr);
+    }
+
+    // Sections saved apart are allocated empty and listed in the layout to be loaded separately, there must be one
+    // if the data has any
+    template <class Archive>
+    void load(Archive& archive, SavedLayout* layout)
+    {
+        release_chunks();
+        cereal::size_type size;
+        archive(m_pos, m_min_height, cereal::make_size_tag(size));
+        m_chunks.resize(size);
+        for (int i = 0; i < static_cast<int>(m_chunks.size()); ++i) {
+            uint8_t section;
+            archive(section);
+            if (section == sc_section_missing) {
+                continue;
+            }
+            m_chunks[i] = new_chunk_data(m_min_height + i);
+            if (section == sc_section_apart || section == sc_section_apart_lit) {
+                VV_REL_ASSERT(layout != nullptr, "[ChunkColumn] Sections saved apart were not expected")
+                layout->heights_apart.push_back(m_min_height + i);
+            }
+            else if (section == sc_section_lit) {
+                m_chunks[i]->load_lit(archive);
+            }
+            else {
+                VV_REL_ASSERT(section == sc_section_inline, "[ChunkColumn] Unknown section format")
+                m_chunks[i]->load_lit(archive);
+                bool spread_light;
+                archive(spread_light);
+                m_chunks[i]->set_spread_light(spread_light);
+            }
+            if (layout != nullptr && (section == sc_section_lit || section == sc_section_apart_lit)) {
+                layout->lit = true;
+            }
+        }
+        archive(m_gen_level);
     }
 
     void set_gen_level(const GenLevel level)
@@ -87,8 +274,27 @@ public:
         return m_pos;
     }
 
+    static constexpr uint8_t sky_light_value(const LightChannel channel)
+    {
+        return channel == LightChannel::sky ? 15 : 0;
+    }
+
 private:
+    // Whether and how each section follows, 0 and 1 being what cereal writes for an empty and a set unique_ptr.
+    // Saves from older versions have the first three, with the light of every voxel in their sections.
+    static constexpr uint8_t sc_section_missing = 0;
+    static constexpr uint8_t sc_section_lit = 1;
+    static constexpr uint8_t sc_section_apart_lit = 2;
+    static constexpr uint8_t sc_section_apart = 3;
+    static constexpr uint8_t sc_section_inline = 4;
+
+    [[nodiscard]] std::unique_ptr<ChunkData> new_chunk_data(int height) const;
+
+    void release_chunks();
+
     GenLevel m_gen_level = none;
     nnm::Vector2i m_pos;
-    std::array<ChunkData, 20> m_chunks = {};
+    int m_min_height = 0;
+    std::vector<std::unique_ptr<ChunkData>> m_chunks {};
+    SectionPool* m_pool = nullptr;
 };
\ No newline at end of file
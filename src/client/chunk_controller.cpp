@@ -1,6 +1,9 @@
 #include "chunk_controller.hpp"
 
 #include <ranges>
+#include <unordered_set>
+
+#include "player.hpp"
 
 #include "world_data.hpp"
 #include "world_generator.hpp"
@@ -15,44 +18,66 @@ void ChunkController::update(
     if (const nnm::Vector2i player_chunk_col = { player_chunk.x, player_chunk.y };
         player_chunk_col != m_player_chunk_col) {
         world_data.set_player_chunk(player_chunk_col);
+        // On spawning or teleporting, everything saved in range is read in one scan instead of column by column
+        if (std::max(
+                std::abs(static_cast<int64_t>(player_chunk_col.x) - m_player_chunk_col.x),
+                std::abs(static_cast<int64_t>(player_chunk_col.y) - m_player_chunk_col.y))
+            > m_render_distance) {
+            world_data.load_region(
+                player_chunk_col - nnm::Vector2i(m_render_distance, m_render_distance),
+                player_chunk_col + nnm::Vector2i(m_render_distance, m_render_distance));
+        }
         m_player_chunk_col = player_chunk_col;
-        on_player_chunk_change();
+        on_player_chunk_change(world_renderer);
     }
 
     int chunk_count = 0;
     for (const nnm::Vector2i col_pos : m_sorted_chunks_in_range) {
-        auto& [flags, neighbors] = m_chunk_states.at(col_pos);
-        if (!contains_flag(flags, flag_is_generated)) {
-            if (!world_data.contains_column(col_pos)) {
-                world_data.create_or_load_chunk(col_pos);
-            }
+        if (!contains_flag(m_chunk_states.at(col_pos).flags, flag_is_generated)) {
+            // Resident and prefetched columns are cheap to bring in, only reading and generating count toward the
+            // frame's budget
+            bool ready = world_data.is_column_ready(col_pos);
+            // Also brings back columns still resident from when they were last in view
+            world_data.create_or_load_chunk(col_pos);
             if (world_data.chunk_column_data_at(col_pos).gen_level() < ChunkColumn::generated) {
                 world_generator.generate_chunk(world_data, col_pos);
                 world_data.queue_save_chunk(col_pos);
+                ready = false;
             }
             for (const nnm::Vector2i offset : sc_nbor_offsets) {
-                if (!m_chunk_states.contains(col_pos + offset)) {
-                    m_chunk_states.insert({ col_pos + offset, {} });
-                }
                 // ReSharper disable once CppUseStructuredBinding
-                ChunkState& neighbor_state = m_chunk_states.at(col_pos + offset);
+                ChunkState& neighbor_state = emplace_state(col_pos + offset, world_renderer);
                 neighbor_state.generated_neighbors++;
                 if (contains_flag(neighbor_state.flags, flag_is_generated)
                     && neighbor_state.generated_neighbors == sc_full_nbors) {
                     enable_flag(neighbor_state.flags, flag_queued_mesh);
                 }
             }
-            enable_flag(flags, flag_is_generated);
-            if (neighbors == sc_full_nbors) {
-                enable_flag(flags, flag_queued_mesh);
+            // Inserting neighbours can grow the grid, so the state is looked up after
+            ChunkState& state = m_chunk_states.at(col_pos);
+            enable_flag(state.flags, flag_is_generated);
+            if (state.generated_neighbors == sc_full_nbors) {
+                enable_flag(state.flags, flag_queued_mesh);
+            }
+            if (!ready) {
+                chunk_count++;
             }
-            chunk_count++;
         }
 
+        auto& [flags, neighbors, mesh_min_height, mesh_max_height] = m_chunk_states.at(col_pos);
         if (contains_flag(flags, flag_queued_mesh)) {
-            for (int h = -10; h < 10; h++) {
-                world_renderer.push_mesh_update({ col_pos.x, col_pos.y, h });
+            ChunkColumn& column = world_data.chunk_column_data_at(col_pos);
+            const WorldData::ColumnLock lock = world_data.lock_columns(col_pos, col_pos, WorldData::LockMode::write);
+            column.for_each_chunk_data([&](ChunkData& chunk) {
+                world_renderer.push_mesh_update(chunk.position());
+                chunk.clear_dirty_region();
+            });
+            if (!contains_flag(flags, flag_has_mesh)) {
+                mesh_min_height = column.min_height();
+                mesh_max_height = column.max_height();
             }
+            mesh_min_height = std::min(mesh_min_height, column.min_height());
+            mesh_max_height = std::max(mesh_max_height, column.max_height());
             enable_flag(flags, flag_has_mesh);
             disable_flag(flags, flag_queued_mesh);
             chunk_count++;
@@ -62,51 +87,185 @@ void ChunkController::update(
         }
     }
 
+    for (const nnm::Vector3i chunk_pos : m_queued_section_meshes) {
+        ChunkState* state = m_chunk_states.find({ chunk_pos.x, chunk_pos.y });
+        if (state == nullptr || !contains_flag(state->flags, flag_has_mesh) || !world_data.contains_chunk(chunk_pos)) {
+            continue;
+        }
+        world_renderer.push_mesh_update(chunk_pos);
+        state->mesh_min_height = std::min(state->mesh_min_height, chunk_pos.z);
+        state->mesh_max_height = std::max(state->mesh_max_height, chunk_pos.z + 1);
+    }
+    m_queued_section_meshes.clear();
+
     world_renderer.process_mesh_updates(world_data);
 
     chunk_count = 0;
-    while (std::optional<nnm::Vector2i> culled_chunk
-           = world_data.try_cull_chunk(static_cast<float>(m_render_distance) + 3.0f)) {
-        if (!m_chunk_states.contains(culled_chunk.value())) {
+    while (std::optional<nnm::Vector2i> culled_chunk = world_data.try_cull_chunk(cull_distance())) {
+        ChunkState* state = m_chunk_states.find(culled_chunk.value());
+        if (state == nullptr) {
             continue;
         }
-        uint8_t& flags = m_chunk_states.at(culled_chunk.value()).flags;
-        if (contains_flag(flags, flag_is_generated)) {
-            for (nnm::Vector2i offset : sc_nbor_offsets) {
-                if (const nnm::Vector2i neighbor = culled_chunk.value() + offset; m_chunk_states.contains(neighbor)) {
-                    if (--m_chunk_states.at(neighbor).generated_neighbors == 0) {
-                        m_chunk_states.erase(neighbor);
-                    }
+        unload_state(culled_chunk.value(), *state, world_renderer);
+        if (++chunk_count > m_mesh_updates_per_frame) {
+            break;
+        }
+    }
+}
+
+void ChunkController::prefetch(WorldData& world_data, const Player& player)
+{
+    const auto to_chunk = [](const nnm::Vector3f block_pos) {
+        const nnm::Vector3i chunk_pos = chunk_pos_from_block_pos(nnm::Vector3i(block_pos.floor()));
+        return nnm::Vector2i(chunk_pos.x, chunk_pos.y);
+    };
+    const auto render_distance = static_cast<float>(m_render_distance);
+    // Further ahead than this the columns would be culled again before the player reaches them
+    const float max_ahead = 2.0f * render_distance * 16.0f;
+    nnm::Vector3f ahead = nnm::Vector3f(player.velocity().x, player.velocity().y, 0.0f) * sc_prefetch_ticks;
+    if (ahead.length() > max_ahead) {
+        ahead = ahead.normalize() * max_ahead;
+    }
+    // Standing still the player is most likely to set off the way it is looking
+    nnm::Vector3f look(player.direction().x, player.direction().y, 0.0f);
+    if (look.length() > 0.0f) {
+        look = look.normalize() * render_distance * 0.5f * 16.0f;
+    }
+    const nnm::Vector2i player_chunk = to_chunk(player.position());
+    const std::array key { player_chunk, to_chunk(player.position() + ahead), to_chunk(player.position() + look) };
+    if (key == m_prefetch_key) {
+        return;
+    }
+    m_prefetch_key = key;
+
+    // Discs around where the player is, then points along the way it is heading and where it is looking. Columns are
+    // wanted in order of the first disc reaching them, nearest its center first.
+    std::vector<nnm::Vector2i> centers { player_chunk };
+    const float step = std::max(1.0f, render_distance * 0.5f) * 16.0f;
+    const int steps = static_cast<int>(nnm::ceil(ahead.length() / step));
+    for (int i = 1; i <= steps; ++i) {
+        centers.push_back(to_chunk(player.position() + ahead * (static_cast<float>(i) / static_cast<float>(steps))));
+    }
+    centers.push_back(key[2]);
+
+    std::vector<nnm::Vector2i> wanted;
+    std::unordered_set<nnm::Vector2i> seen;
+    std::vector<nnm::Vector2i> disc;
+    for (const nnm::Vector2i center : centers) {
+        disc.clear();
+        for_2d(
+            center - nnm::Vector2i(m_render_distance, m_render_distance),
+            center + nnm::Vector2i(m_render_distance + 1, m_render_distance + 1),
+            [&](const nnm::Vector2i pos) {
+                if ((pos - center).length_sqrd() <= nnm::sqrd(m_render_distance) && !world_data.contains_column(pos)
+                    && seen.insert(pos).second) {
+                    disc.push_back(pos);
                 }
+            });
+        std::ranges::sort(disc, [&](const nnm::Vector2i a, const nnm::Vector2i b) {
+            return (a - center).length_sqrd() < (b - center).length_sqrd();
+        });
+        for (const nnm::Vector2i pos : disc) {
+            if (wanted.size() == sc_max_prefetch) {
+                break;
             }
-            disable_flag(flags, flag_is_generated);
+            wanted.push_back(pos);
         }
-        if (contains_flag(flags, flag_has_mesh)) {
-            for (int h = -10; h < 10; h++) {
-                world_renderer.remove_data({ culled_chunk.value().x, culled_chunk.value().y, h });
-            }
-            disable_flag(flags, flag_has_mesh);
+    }
+    world_data.prefetch_columns(wanted);
+}
+
+void ChunkController::queue_dirty_meshes(WorldData& world_data, const nnm::Vector3i chunk_pos)
+{
+    // Relighting after an edit reaches up to two sections out
+    const WorldData::ColumnLock lock = world_data.lock_columns(
+        { chunk_pos.x - 2, chunk_pos.y - 2 }, { chunk_pos.x + 2, chunk_pos.y + 2 }, WorldData::LockMode::write);
+    for_3d({ -2, -2, -2 }, { 3, 3, 3 }, [&](const nnm::Vector3i offset) {
+        const nnm::Vector3i dirty_pos = chunk_pos + offset;
+        if (!world_data.contains_chunk(dirty_pos)) {
+            return;
+        }
+        ChunkData& chunk = world_data.chunk_data_at(dirty_pos);
+        const std::optional<DirtyRegion> region = chunk.dirty_region();
+        if (!region.has_value()) {
+            return;
         }
+        // Neighbours only read a one voxel border of this section, so only the sides the region touches matter
+        const nnm::Vector3i from {
+            region->min.x == 0 ? -1 : 0, region->min.y == 0 ? -1 : 0, region->min.z == 0 ? -1 : 0
+        };
+        const nnm::Vector3i to {
+            region->max.x == 15 ? 2 : 1, region->max.y == 15 ? 2 : 1, region->max.z == 15 ? 2 : 1
+        };
+        for_3d(from, to, [&](const nnm::Vector3i neighbor) {
+            m_queued_section_meshes.push_back(dirty_pos + neighbor);
+        });
+        chunk.clear_dirty_region();
+    });
+}
 
-        disable_flag(flags, flag_queued_mesh);
-        if (++chunk_count > m_mesh_updates_per_frame) {
-            break;
+void ChunkController::unload_state(const nnm::Vector2i pos, ChunkState& state, WorldRenderer& world_renderer)
+{
+    uint8_t& flags = state.flags;
+    if (contains_flag(flags, flag_is_generated)) {
+        for (nnm::Vector2i offset : sc_nbor_offsets) {
+            if (ChunkState* neighbor_state = m_chunk_states.find(pos + offset); neighbor_state != nullptr) {
+                if (--neighbor_state->generated_neighbors == 0) {
+                    m_chunk_states.erase(pos + offset);
+                }
+            }
         }
+        disable_flag(flags, flag_is_generated);
     }
+    if (contains_flag(flags, flag_has_mesh)) {
+        for (int h = state.mesh_min_height; h < state.mesh_max_height; h++) {
+            if (const nnm::Vector3i chunk_pos { pos.x, pos.y, h }; world_renderer.contains_data(chunk_pos)) {
+                world_renderer.remove_data(chunk_pos);
+            }
+        }
+        disable_flag(flags, flag_has_mesh);
+    }
+    disable_flag(flags, flag_queued_mesh);
 }
 
-void ChunkController::queue_recreate_mesh(const nnm::Vector2i chunk_pos)
+bool ChunkController::is_stale(const nnm::Vector2i pos) const
 {
-    if (m_chunk_states.contains(chunk_pos)) {
-        if (uint8_t& flags = m_chunk_states.at(chunk_pos).flags;
-            contains_flag(flags, flag_is_generated) && contains_flag(flags, flag_has_mesh)) {
-            enable_flag(flags, flag_queued_mesh);
-        }
+    // Same distance WorldData evicts columns in view at, see WorldData::evict_occupant
+    return nnm::Vector2f(pos).distance(nnm::Vector2f(m_player_chunk_col)) > 2.0f * cull_distance();
+}
+
+void ChunkController::drop_state(const nnm::Vector2i pos, WorldRenderer& world_renderer)
+{
+    // Gone already if it lost its last generated neighbour to an earlier drop
+    if (ChunkState* state = m_chunk_states.find(pos); state != nullptr) {
+        unload_state(pos, *state, world_renderer);
+        m_chunk_states.erase(pos);
+    }
+}
+
+ChunkController::ChunkState& ChunkController::emplace_state(const nnm::Vector2i pos, WorldRenderer& world_renderer)
+{
+    // Stale states holding the slot would otherwise grow the grid
+    if (const std::optional<nnm::Vector2i> occupant = m_chunk_states.occupant(pos);
+        occupant.has_value() && *occupant != pos && is_stale(*occupant)) {
+        drop_state(*occupant, world_renderer);
     }
+    return *m_chunk_states.try_emplace(pos).first;
 }
 
-void ChunkController::on_player_chunk_change()
+void ChunkController::on_player_chunk_change(WorldRenderer& world_renderer)
 {
+    // Columns are only culled a few per frame, states left behind by a fast moving player are dropped here instead
+    std::vector<nnm::Vector2i> stale;
+    m_chunk_states.for_each([&](const nnm::Vector2i pos, const ChunkState&) {
+        if (is_stale(pos)) {
+            stale.push_back(pos);
+        }
+    });
+    for (const nnm::Vector2i pos : stale) {
+        drop_state(pos, world_renderer);
+    }
+
     m_sorted_chunks_in_range.clear();
     for_2d(
         nnm::Vector2i(-m_render_distance, -m_render_distance)
@@ -115,14 +274,11 @@ void ChunkController::on_player_chunk_change()
         [&](const nnm::Vector2i pos) {
             if (nnm::abs(nnm::sqrd(pos.x - m_player_chunk_col.x) + nnm::sqrd(pos.y - m_player_chunk_col.y))
                 <= nnm::sqrd(m_render_distance)) {
-                if (!m_chunk_states.contains(pos)) {
-                    m_chunk_states[pos] = {};
-                }
+                emplace_state(pos, world_renderer);
             }
         });
-    for (const auto& pos : m_chunk_states | std::views::keys) {
-        m_sorted_chunks_in_range.push_back(pos);
-    }
+    m_chunk_states.for_each(
+        [&](const nnm::Vector2i pos, const ChunkState&) { m_sorted_chunks_in_range.push_back(pos); });
     std::ranges::sort(m_sorted_chunks_in_range, [&](const nnm::Vector2i& a, const nnm::Vector2i& b) {
         return nnm::Vector2f(a).distance_sqrd(
                    nnm::Vector2f(static_cast<float>(m_player_chunk_col.x), static_cast<float>(m_player_chunk_col.y)))
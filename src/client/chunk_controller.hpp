@@ -2,13 +2,15 @@
 
 #include <array>
 #include <cstdint>
-#include <unordered_map>
 #include <vector>
 
 #include "common.hpp"
 
 #include <nnm/nnm.hpp>
 
+#include "column_grid.hpp"
+
+class Player;
 class WorldData;
 class WorldGenerator;
 class WorldRenderer;
@@ -33,7 +35,12 @@ public:
         return *this;
     }
 
-    void queue_recreate_mesh(nnm::Vector2i chunk_pos);
+    // Asks the world to read ahead the saved columns the player is expected to bring into range over the next couple
+    // of seconds, going by where it is heading and looking
+    void prefetch(WorldData& world_data, const Player& player);
+
+    // Queues remeshes for the sections around an edit whose changes reach them, then clears their dirty regions
+    void queue_dirty_meshes(WorldData& world_data, nnm::Vector3i chunk_pos);
 
 private:
     enum ChunkFlagBits {
@@ -63,16 +70,45 @@ private:
     struct ChunkState {
         uint8_t flags {};
         int generated_neighbors = 0;
+        // Section heights that have been sent to the renderer
+        int mesh_min_height = 0;
+        int mesh_max_height = 0;
     };
 
-    void on_player_chunk_change();
+    // Columns farther than this from the player are culled
+    [[nodiscard]] float cull_distance() const
+    {
+        return static_cast<float>(m_render_distance) + 3.0f;
+    }
+
+    // Removes the state's meshes and its count from its neighbours, erasing those left without generated neighbours
+    void unload_state(nnm::Vector2i pos, ChunkState& state, WorldRenderer& world_renderer);
+
+    // Whether the position is too far from the player to keep a state for
+    [[nodiscard]] bool is_stale(nnm::Vector2i pos) const;
+
+    void drop_state(nnm::Vector2i pos, WorldRenderer& world_renderer);
+
+    // Drops a stale state holding the position's slot before inserting
+    ChunkState& emplace_state(nnm::Vector2i pos, WorldRenderer& world_renderer);
+
+    void on_player_chunk_change(WorldRenderer& world_renderer);
+
+    // Two seconds of the fixed update
+    static constexpr float sc_prefetch_ticks = 120.0f;
+    static constexpr size_t sc_max_prefetch = 256;
 
     inline static const std::array<nnm::Vector2i, 4> sc_nbor_offsets { { { 0, 1 }, { 0, -1 }, { 1, 0 }, { -1, 0 } } };
     static constexpr int sc_full_nbors = sc_nbor_offsets.size();
 
     nnm::Vector2i m_player_chunk_col = { std::numeric_limits<int>::max(), std::numeric_limits<int>::max() };
     std::vector<nnm::Vector2i> m_sorted_chunks_in_range {};
-    std::unordered_map<nnm::Vector2i, ChunkState> m_chunk_states;
+    ColumnGrid<ChunkState> m_chunk_states;
+    std::vector<nnm::Vector3i> m_queued_section_meshes {};
+    // Chunks the last prefetch went by, it is only redone when one of them changes
+    std::array<nnm::Vector2i, 3> m_prefetch_key {
+        { { std::numeric_limits<int>::max(), std::numeric_limits<int>::max() } }
+    };
     int m_render_distance = 0;
     int m_mesh_updates_per_frame = 0;
 };
\ No newline at end of file
@@ -1,23 +1,260 @@
 #include "chunk_data.hpp"
 
+#include <algorithm>
+#include <atomic>
+
+static uint64_t next_version_base()
+{
+    // Zero and one are left free for callers to mark missing sections
+    static std::atomic<uint64_t> next_base = 1;
+    return next_base.fetch_add(1, std::memory_order_relaxed) << 32;
+}
+
 ChunkData::ChunkData()
+    : m_version(next_version_base())
+    , m_block_version(m_version)
+    , m_lit_block_version(m_version - 1)
 {
     // reset_lighting(15);
 }
 
 ChunkData::ChunkData(const nnm::Vector3i chunk_pos)
     : m_pos(chunk_pos)
+    , m_version(next_version_base())
+    , m_block_version(m_version)
+    , m_lit_block_version(m_version - 1)
 {
     // reset_lighting(15);
 }
 void ChunkData::set_block(const nnm::Vector3i pos, const uint8_t type)
 {
     VV_DEB_ASSERT(is_block_pos_local(pos), "[ChunkData] Invalid local block position");
-    if (m_block_data[index(pos)] == 0 && type != 0) {
+    const uint8_t prev_type = get_block(pos);
+    if (prev_type == type) {
+        return;
+    }
+    if (prev_type == 0) {
         m_block_count++;
     }
-    else if (m_block_data[index(pos)] != 0 && type == 0) {
+    else if (type == 0) {
         m_block_count--;
     }
-    m_block_data[index(pos)] = type;
+    m_block_version++;
+    mark_dirty(pos, pos);
+    if (m_solid_rows.empty()) {
+        // Leaving the uniform state, every row starts out as the derived one
+        m_solid_rows.write().assign(sc_chunk_size * sc_chunk_size, solid_row(0, 0));
+        m_transparent_rows.write().assign(sc_chunk_size * sc_chunk_size, transparent_row(0, 0));
+    }
+    set_row_bits(pos, type);
+    const size_t i = index(pos);
+    if (m_bits_per_block == sc_direct_bits) {
+        set_packed(i, type);
+        return;
+    }
+    const auto palette_end = m_palette.begin() + m_palette_size;
+    if (const auto it = std::find(m_palette.begin(), palette_end, type); it != palette_end) {
+        set_packed(i, static_cast<uint8_t>(it - m_palette.begin()));
+        return;
+    }
+    if (m_palette_size == 1 << m_bits_per_block) {
+        std::array<uint8_t, 256> remap {};
+        const int bits = m_bits_per_block == 0 ? 1 : m_bits_per_block * 2;
+        for (int p = 0; p < m_palette_size; ++p) {
+            remap[p] = bits == sc_direct_bits ? m_palette[p] : static_cast<uint8_t>(p);
+        }
+        repack(bits, remap);
+        if (m_bits_per_block == sc_direct_bits) {
+            set_packed(i, type);
+            return;
+        }
+    }
+    m_palette[m_palette_size] = type;
+    set_packed(i, static_cast<uint8_t>(m_palette_size));
+    m_palette_size++;
+}
+
+void ChunkData::reset_light(const LightChannel channel, const uint8_t value)
+{
+    VV_DEB_ASSERT(value <= 15, "[ChunkData] Lighting is not between 0 and 15")
+    const int shift = static_cast<int>(channel);
+    const auto keep_mask = static_cast<uint8_t>(~(0x0F << shift));
+    const auto channel_bits = static_cast<uint8_t>(value << shift);
+    const uint8_t prev_uniform = m_uniform_lighting;
+    m_uniform_lighting = static_cast<uint8_t>(m_uniform_lighting & keep_mask | channel_bits);
+    if (!m_lighting_data.empty()) {
+        for (uint8_t& packed : m_lighting_data.write()) {
+            packed = static_cast<uint8_t>(packed & keep_mask | channel_bits);
+        }
+    }
+    if (!m_lighting_data.empty() || m_uniform_lighting != prev_uniform) {
+        mark_light_dirty({ 0, 0, 0 }, { 15, 15, 15 });
+    }
 }
+
+void ChunkData::begin_light_rebuild()
+{
+    VV_DEB_ASSERT(!m_rebuilding_light, "[ChunkData] Light rebuild already started")
+    m_rebuilding_light = true;
+    m_uniform_lighting_before = m_uniform_lighting;
+    m_lighting_data_before = m_lighting_data;
+}
+
+void ChunkData::end_light_rebuild()
+{
+    VV_DEB_ASSERT(m_rebuilding_light, "[ChunkData] Light rebuild not started")
+    m_rebuilding_light = false;
+    if (m_lighting_data.empty() && m_lighting_data_before.empty()) {
+        if (m_uniform_lighting != m_uniform_lighting_before) {
+            mark_dirty({ 0, 0, 0 }, { 15, 15, 15 });
+        }
+        return;
+    }
+    nnm::Vector3i min { sc_chunk_size, sc_chunk_size, sc_chunk_size };
+    nnm::Vector3i max { -1, -1, -1 };
+    for (int i = 0; i < sc_volume; ++i) {
+        const uint8_t before
+            = m_lighting_data_before.empty() ? m_uniform_lighting_before : m_lighting_data_before[i];
+        // ReSharper disable once CppTooWideScopeInitStatement
+        const uint8_t after = m_lighting_data.empty() ? m_uniform_lighting : m_lighting_data[i];
+        if (before != after) {
+            const nnm::Vector3i p = pos(i);
+            min = { std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z) };
+            max = { std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z) };
+        }
+    }
+    if (max.x >= 0) {
+        mark_dirty(min, max);
+    }
+    m_lighting_data_before.clear();
+    m_lighting_data_before.shrink_to_fit();
+}
+
+void ChunkData::compact()
+{
+    if (!m_lighting_data.empty()) {
+        if (std::ranges::all_of(m_lighting_data, [&](const uint8_t val) { return val == m_lighting_data[0]; })) {
+            m_uniform_lighting = m_lighting_data[0];
+            m_lighting_data.clear();
+        }
+    }
+    m_lighting_data.shrink_to_fit();
+    if (m_bits_per_block == 0) {
+        return;
+    }
+    std::array<bool, 256> used {};
+    for (int i = 0; i < sc_volume; ++i) {
+        used[packed_at(i)] = true;
+    }
+    std::array<uint8_t, sc_max_palette_size> palette {};
+    std::array<uint8_t, 256> remap {};
+    int palette_size = 0;
+    for (int value = 0; value < 256; ++value) {
+        if (!used[value]) {
+            continue;
+        }
+        const uint8_t type = m_bits_per_block == sc_direct_bits ? static_cast<uint8_t>(value) : m_palette[value];
+        if (palette_size < sc_max_palette_size) {
+            palette[palette_size] = type;
+        }
+        remap[value] = static_cast<uint8_t>(palette_size);
+        palette_size++;
+    }
+    int bits = sc_direct_bits;
+    for (const int candidate : { 0, 1, 2, 4 }) {
+        if (palette_size <= 1 << candidate) {
+            bits = candidate;
+            break;
+        }
+    }
+    if (bits == m_bits_per_block && palette_size == m_palette_size) {
+        return;
+    }
+    if (bits == sc_direct_bits) {
+        // Already direct and too many types to palette
+        return;
+    }
+    repack(bits, remap);
+    m_palette = palette;
+    m_palette_size = palette_size;
+    if (m_bits_per_block == 0) {
+        m_solid_rows.clear();
+        m_solid_rows.shrink_to_fit();
+        m_transparent_rows.clear();
+        m_transparent_rows.shrink_to_fit();
+    }
+}
+
+bool ChunkData::has_same_lighting(const ChunkData& other) const
+{
+    if (m_lighting_data.empty() && other.m_lighting_data.empty()) {
+        return m_uniform_lighting == other.m_uniform_lighting;
+    }
+    for (int i = 0; i < sc_volume; ++i) {
+        const uint8_t light = m_lighting_data.empty() ? m_uniform_lighting : m_lighting_data[i];
+        if (const uint8_t other_light = other.m_lighting_data.empty() ? other.m_uniform_lighting
+                                                                      : other.m_lighting_data[i];
+            light != other_light) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ChunkData::copy_lighting(const ChunkData& other)
+{
+    m_uniform_lighting = other.m_uniform_lighting;
+    m_lighting_data = other.m_lighting_data;
+    mark_light_dirty({ 0, 0, 0 }, { 15, 15, 15 });
+}
+
+void ChunkData::recycle(const nnm::Vector3i chunk_pos)
+{
+    m_pos = chunk_pos;
+    m_bits_per_block = 0;
+    m_palette_size = 1;
+    m_palette = { 0 };
+    m_packed_data.clear();
+    m_uniform_lighting = 0;
+    m_lighting_data.clear();
+    m_spread_light = false;
+    m_solid_rows.clear();
+    m_transparent_rows.clear();
+    m_block_count = 0;
+    m_version = next_version_base();
+    m_block_version = m_version;
+    m_lit_block_version = m_version - 1;
+    m_dirty_region.reset();
+    m_rebuilding_light = false;
+    m_uniform_lighting_before = 0;
+    m_lighting_data_before.clear();
+}
+
+void ChunkData::repack(const int bits, const std::array<uint8_t, 256>& remap)
+{
+    std::vector<uint64_t> data(sc_volume * bits / 64, 0);
+    if (bits != 0) {
+        const uint64_t mask = (uint64_t { 1 } << bits) - 1;
+        for (int i = 0; i < sc_volume; ++i) {
+            const uint8_t value = m_bits_per_block == 0 ? 0 : packed_at(i);
+            const size_t bit = i * bits;
+            data[bit >> 6] |= (remap[value] & mask) << (bit & 63);
+        }
+    }
+    m_packed_data = CowVector(std::move(data));
+    m_bits_per_block = bits;
+}
+
+void ChunkData::rebuild_rows()
+{
+    m_solid_rows.clear();
+    m_transparent_rows.clear();
+    if (m_bits_per_block == 0) {
+        return;
+    }
+    m_solid_rows.write().assign(sc_chunk_size * sc_chunk_size, 0);
+    m_transparent_rows.write().assign(sc_chunk_size * sc_chunk_size, 0);
+    for (int i = 0; i < sc_volume; ++i) {
+        set_row_bits(pos(i), get_block(pos(i)));
+    }
+}
\ No newline at end of file
@@ -1,14 +1,19 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <optional>
+#include <vector>
 
 // ReSharper disable once CppUnusedIncludeDirective
 #include <cereal/types/array.hpp>
 // ReSharper disable once CppUnusedIncludeDirective
 #include <cereal/types/vector.hpp>
 
+#include "block_registry.hpp"
 #include "common.hpp"
+#include "cow_vector.hpp"
 
 #include <nnm/nnm.hpp>
 
@@ -54,17 +59,33 @@ inline Direction opposite_direction(const Direction dir)
     }
 }
 
+enum class LightChannel { sky = 4, block = 0 };
+
+// Inclusive local bounds of the voxels written since a section's region was last cleared
+struct DirtyRegion {
+    nnm::Vector3i min;
+    nnm::Vector3i max;
+};
+
 class ChunkData {
 public:
     ChunkData();
 
     explicit ChunkData(nnm::Vector3i chunk_pos);
 
-    void reset_lighting(const uint8_t value = 0)
+    // Drops back to a single uniform light value, the array is re-expanded on the next differing write
+    void reset_lighting(const uint8_t sky = 0, const uint8_t block = 0)
     {
-        std::ranges::fill(m_lighting_data, value);
+        if (m_lighting_data.empty() && m_uniform_lighting == pack_light(sky, block)) {
+            return;
+        }
+        m_lighting_data.clear();
+        m_uniform_lighting = pack_light(sky, block);
+        mark_light_dirty({ 0, 0, 0 }, { 15, 15, 15 });
     }
 
+    void reset_light(LightChannel channel, uint8_t value);
+
     [[nodiscard]] nnm::Vector3i position() const
     {
         return m_pos;
@@ -74,20 +95,86 @@ public:
     [[nodiscard]] uint8_t get_block(const nnm::Vector3i pos) const
     {
         VV_DEB_ASSERT(is_block_pos_local(pos), "[ChunkData] Invalid local block position");
-        return m_block_data[index(pos)];
+        if (m_bits_per_block == 0) {
+            return m_palette[0];
+        }
+        const uint8_t value = packed_at(index(pos));
+        return m_bits_per_block == sc_direct_bits ? value : m_palette[value];
     }
 
-    void set_lighting(const nnm::Vector3i pos, const uint8_t val)
+    void set_light(const nnm::Vector3i pos, const LightChannel channel, const uint8_t val)
     {
         VV_DEB_ASSERT(is_block_pos_local(pos), "[ChunkData] Invalid local block position");
         VV_DEB_ASSERT(val <= 15, "[ChunkData] Lighting is not between 0 and 15")
-        m_lighting_data[index(pos)] = val;
+        const int shift = static_cast<int>(channel);
+        const auto keep_mask = static_cast<uint8_t>(~(0x0F << shift));
+        if (m_lighting_data.empty()) {
+            if (const auto packed = static_cast<uint8_t>(m_uniform_lighting & keep_mask | val << shift);
+                packed == m_uniform_lighting) {
+                return;
+            }
+            m_lighting_data.write().assign(sc_volume, m_uniform_lighting);
+        }
+        uint8_t& packed = m_lighting_data.write()[index(pos)];
+        const auto new_packed = static_cast<uint8_t>(packed & keep_mask | val << shift);
+        if (new_packed != packed) {
+            packed = new_packed;
+            mark_light_dirty(pos, pos);
+        }
+    }
+
+    [[nodiscard]] uint8_t light_at(const nnm::Vector3i pos, const LightChannel channel) const
+    {
+        return packed_light_at(pos) >> static_cast<int>(channel) & 0x0F;
     }
 
+    // Brightest of the two channels, which is what the mesher shades with
     [[nodiscard]] uint8_t lighting_at(const nnm::Vector3i pos) const
+    {
+        const uint8_t packed = packed_light_at(pos);
+        return std::max<uint8_t>(packed >> 4, packed & 0x0F);
+    }
+
+    // Skylight lives in the high nibble and blocklight in the low nibble of each light byte
+    static constexpr uint8_t pack_light(const uint8_t sky, const uint8_t block)
+    {
+        return static_cast<uint8_t>(sky << 4 | block);
+    }
+
+    [[nodiscard]] uint8_t packed_light_at(const nnm::Vector3i pos) const
     {
         VV_DEB_ASSERT(is_block_pos_local(pos), "[ChunkData] Invalid local block position");
-        return m_lighting_data[index(pos)];
+        return m_lighting_data.empty() ? m_uniform_lighting : m_lighting_data[index(pos)];
+    }
+
+    // Bit x of a row is set when the voxel at (x, y, z) is not air
+    [[nodiscard]] uint16_t solid_row(const int y, const int z) const
+    {
+        if (m_solid_rows.empty()) {
+            return m_palette[0] != 0 ? sc_full_row : 0;
+        }
+        return m_solid_rows[index2({ y, z })];
+    }
+
+    // Bit x of a row is set when light and neighbouring faces show through the voxel at (x, y, z)
+    [[nodiscard]] uint16_t transparent_row(const int y, const int z) const
+    {
+        if (m_transparent_rows.empty()) {
+            return is_transparent(m_palette[0]) ? sc_full_row : 0;
+        }
+        return m_transparent_rows[index2({ y, z })];
+    }
+
+    [[nodiscard]] bool is_solid_at(const nnm::Vector3i pos) const
+    {
+        VV_DEB_ASSERT(is_block_pos_local(pos), "[ChunkData] Invalid local block position");
+        return solid_row(pos.y, pos.z) >> pos.x & 1;
+    }
+
+    [[nodiscard]] bool is_transparent_at(const nnm::Vector3i pos) const
+    {
+        VV_DEB_ASSERT(is_block_pos_local(pos), "[ChunkData] Invalid local block position");
+        return transparent_row(pos.y, pos.z) >> pos.x & 1;
     }
 
     [[nodiscard]] int block_count() const
@@ -95,21 +182,202 @@ public:
         return m_block_count;
     }
 
+    // Bumped on every change to blocks or light. Each section starts from its own range so a section that replaces
+    // another never repeats its versions.
+    [[nodiscard]] uint64_t version() const
+    {
+        return m_version;
+    }
+
+    // Bumped only when blocks change, which is all that lighting depends on
+    [[nodiscard]] uint64_t block_version() const
+    {
+        return m_block_version;
+    }
+
+    [[nodiscard]] std::optional<DirtyRegion> dirty_region() const
+    {
+        return m_dirty_region;
+    }
+
+    void clear_dirty_region()
+    {
+        m_dirty_region.reset();
+    }
+
+    // Whether light has been propagated since the blocks last changed
+    [[nodiscard]] bool is_lit() const
+    {
+        return m_lit_block_version == m_block_version;
+    }
+
+    void mark_lit()
+    {
+        m_lit_block_version = m_block_version;
+    }
+
+    // Light written between these two calls only counts as a change where it ends up different from before, so
+    // recomputing light from scratch does not dirty the whole section
+    void begin_light_rebuild();
+
+    void end_light_rebuild();
+
+    // Whether light spread into the section from its neighbours or its own light sources. Rebuilding that takes the
+    // neighbours, so it is saved with the section. Sunlight alone is left out and rebuilt on load.
+    [[nodiscard]] bool has_spread_light() const
+    {
+        return m_spread_light;
+    }
+
+    void set_spread_light(const bool spread)
+    {
+        m_spread_light = spread;
+    }
+
+    [[nodiscard]] bool has_same_lighting(const ChunkData& other) const;
+
+    // Takes the light of the other section, sharing its storage like a snapshot
+    void copy_lighting(const ChunkData& other);
+
+    // Bits used per voxel for the packed palette indices (0, 1, 2, 4 or 8)
+    [[nodiscard]] int bits_per_block() const
+    {
+        return m_bits_per_block;
+    }
+
+    // Single block type and a single light value, stored without any per-voxel arrays
+    [[nodiscard]] bool is_uniform() const
+    {
+        return m_bits_per_block == 0 && m_lighting_data.empty();
+    }
+
+    // Approximate heap and object bytes, for budgeting resident columns
+    [[nodiscard]] size_t memory_usage() const
+    {
+        return sizeof(ChunkData) + m_packed_data.memory_usage() + m_lighting_data.memory_usage()
+            + m_solid_rows.memory_usage() + m_transparent_rows.memory_usage()
+            + m_lighting_data_before.memory_usage();
+    }
+
+    // Shrinks the palette to the block types still in use, repacks at the smallest bit width and collapses
+    // lighting back to a single value when every voxel matches
+    void compact();
+
+    // Immutable copy of the section as it is now, sharing its storage until the section is next written. Safe to read
+    // from any thread, to be taken on the thread that writes the section or while holding it off.
+    [[nodiscard]] ChunkData snapshot() const
+    {
+        return *this;
+    }
+
+    // Puts the section back into the state of a newly constructed one at a new position and version, keeping the
+    // capacity of its buffers for whoever gets it next
+    void recycle(nnm::Vector3i chunk_pos);
+
+    template <class Archive>
+    void save(Archive& archive) const
+    {
+        archive(m_pos, m_bits_per_block, m_palette_size, m_palette, m_packed_data, m_block_count, m_spread_light);
+        if (m_spread_light) {
+            archive(m_uniform_lighting, m_lighting_data);
+        }
+    }
+
+    // Sections without spread light load dark, see relight_loaded_column
+    template <class Archive>
+    void load(Archive& archive)
+    {
+        archive(m_pos, m_bits_per_block, m_palette_size, m_palette, m_packed_data, m_block_count, m_spread_light);
+        if (m_spread_light) {
+            archive(m_uniform_lighting, m_lighting_data);
+        }
+        else {
+            m_uniform_lighting = 0;
+            m_lighting_data.clear();
+        }
+        rebuild_rows();
+    }
+
+    // With the light of every voxel, as sections were saved before sunlight was left out. Loaded light is kept as
+    // spread light until relighting finds it to be sunlight.
     template <class Archive>
-    void serialize(Archive& archive)
+    void save_lit(Archive& archive) const
     {
-        archive(m_pos, m_block_data, m_lighting_data, m_block_count);
+        archive(
+            m_pos,
+            m_bits_per_block,
+            m_palette_size,
+            m_palette,
+            m_packed_data,
+            m_uniform_lighting,
+            m_lighting_data,
+            m_block_count);
+    }
+
+    template <class Archive>
+    void load_lit(Archive& archive)
+    {
+        archive(
+            m_pos,
+            m_bits_per_block,
+            m_palette_size,
+            m_palette,
+            m_packed_data,
+            m_uniform_lighting,
+            m_lighting_data,
+            m_block_count);
+        m_spread_light = true;
+        rebuild_rows();
     }
 
 private:
+    // Voxel order is picked at compile time (see VV_CHUNK_LAYOUT in CMakeLists.txt), saves are only readable with
+    // the layout that wrote them
+#if defined(VV_CHUNK_LAYOUT_MORTON)
+    // Bits of x, y and z interleaved, so nearby voxels on every axis stay close in memory
     static size_t index(const nnm::Vector3i pos)
     {
-        return pos.x + pos.y * sc_chunk_size + pos.z * sc_chunk_size * sc_chunk_size;
+        return sc_morton_spread[pos.x] | sc_morton_spread[pos.y] << 1 | sc_morton_spread[pos.z] << 2;
     }
 
-    static size_t index2(const nnm::Vector2i pos)
+    static nnm::Vector3i pos(const int index)
     {
-        return pos.x + pos.y * sc_chunk_size;
+        nnm::Vector3i vector;
+        for (int bit = 0; bit < 4; ++bit) {
+            vector.x |= (index >> (bit * 3) & 1) << bit;
+            vector.y |= (index >> (bit * 3 + 1) & 1) << bit;
+            vector.z |= (index >> (bit * 3 + 2) & 1) << bit;
+        }
+        return vector;
+    }
+
+    static constexpr std::array<uint16_t, 16> sc_morton_spread = [] {
+        std::array<uint16_t, 16> spread {};
+        for (int value = 0; value < 16; ++value) {
+            for (int bit = 0; bit < 4; ++bit) {
+                spread[value] |= static_cast<uint16_t>((value >> bit & 1) << (bit * 3));
+            }
+        }
+        return spread;
+    }();
+#elif defined(VV_CHUNK_LAYOUT_TILED)
+    // 4x4x4 tiles of 64 voxels, linear inside each tile and tiles linear within the section
+    static size_t index(const nnm::Vector3i pos)
+    {
+        const int tile = (pos.x >> 2) + (pos.y >> 2) * 4 + (pos.z >> 2) * 16;
+        return tile << 6 | (pos.x & 3) + (pos.y & 3) * 4 + (pos.z & 3) * 16;
+    }
+
+    static nnm::Vector3i pos(const int index)
+    {
+        const int tile = index >> 6;
+        const int inner = index & 63;
+        return { (tile & 3) << 2 | inner & 3, (tile >> 2 & 3) << 2 | inner >> 2 & 3, tile >> 4 << 2 | inner >> 4 };
+    }
+#else
+    static size_t index(const nnm::Vector3i pos)
+    {
+        return pos.x + pos.y * sc_chunk_size + pos.z * sc_chunk_size * sc_chunk_size;
     }
 
     static nnm::Vector3i pos(const int index)
@@ -120,6 +388,12 @@ private:
         vector.z = index / (sc_chunk_size * sc_chunk_size);
         return vector;
     }
+#endif
+
+    static size_t index2(const nnm::Vector2i pos)
+    {
+        return pos.x + pos.y * sc_chunk_size;
+    }
 
     static nnm::Vector2i pos2(const int index)
     {
@@ -129,9 +403,80 @@ private:
         return vector;
     }
 
+    // Bit widths are powers of two so an entry never straddles two words
+    [[nodiscard]] uint8_t packed_at(const size_t i) const
+    {
+        const size_t bit = i * m_bits_per_block;
+        const uint64_t mask = (uint64_t { 1 } << m_bits_per_block) - 1;
+        return static_cast<uint8_t>(m_packed_data[bit >> 6] >> (bit & 63) & mask);
+    }
+
+    void set_packed(const size_t i, const uint8_t value)
+    {
+        const size_t bit = i * m_bits_per_block;
+        const uint64_t mask = ((uint64_t { 1 } << m_bits_per_block) - 1) << (bit & 63);
+        uint64_t& word = m_packed_data.write()[bit >> 6];
+        word = (word & ~mask) | (static_cast<uint64_t>(value) << (bit & 63) & mask);
+    }
+
+    void repack(int bits, const std::array<uint8_t, 256>& remap);
+
+    void set_row_bits(const nnm::Vector3i pos, const uint8_t type)
+    {
+        const auto bit = static_cast<uint16_t>(1 << pos.x);
+        uint16_t& solid = m_solid_rows.write()[index2({ pos.y, pos.z })];
+        solid = type != 0 ? solid | bit : solid & ~bit;
+        uint16_t& transparent = m_transparent_rows.write()[index2({ pos.y, pos.z })];
+        transparent = is_transparent(type) ? transparent | bit : transparent & ~bit;
+    }
+
+    void rebuild_rows();
+
+    void mark_dirty(const nnm::Vector3i min, const nnm::Vector3i max)
+    {
+        m_version++;
+        if (!m_dirty_region.has_value()) {
+            m_dirty_region = { min, max };
+            return;
+        }
+        DirtyRegion& region = *m_dirty_region;
+        region.min = { std::min(region.min.x, min.x), std::min(region.min.y, min.y), std::min(region.min.z, min.z) };
+        region.max = { std::max(region.max.x, max.x), std::max(region.max.y, max.y), std::max(region.max.z, max.z) };
+    }
+
+    void mark_light_dirty(const nnm::Vector3i min, const nnm::Vector3i max)
+    {
+        if (!m_rebuilding_light) {
+            mark_dirty(min, max);
+        }
+    }
+
     static constexpr int sc_chunk_size = 16;
+    static constexpr int sc_volume = sc_chunk_size * sc_chunk_size * sc_chunk_size;
+    // At 8 bits the palette is bypassed and the packed values are the block types themselves
+    static constexpr int sc_direct_bits = 8;
+    static constexpr int sc_max_palette_size = 16;
+    static constexpr uint16_t sc_full_row = 0xFFFF;
+
     nnm::Vector3i m_pos;
-    std::array<uint8_t, sc_chunk_size * sc_chunk_size * sc_chunk_size> m_block_data = { 0 };
-    std::array<uint8_t, sc_chunk_size * sc_chunk_size * sc_chunk_size> m_lighting_data = { 0 };
+    int m_bits_per_block = 0;
+    int m_palette_size = 1;
+    std::array<uint8_t, sc_max_palette_size> m_palette = { 0 };
+    // Per-voxel storage is shared with snapshots until written, see snapshot()
+    CowVector<uint64_t> m_packed_data {};
+    uint8_t m_uniform_lighting = 0;
+    CowVector<uint8_t> m_lighting_data {};
+    bool m_spread_light = false;
+    // One row per (y, z), only stored while the section holds more than one block type
+    CowVector<uint16_t> m_solid_rows {};
+    CowVector<uint16_t> m_transparent_rows {};
     int m_block_count = 0;
+    // Runtime only, loading a section starts it at a fresh version
+    uint64_t m_version;
+    uint64_t m_block_version;
+    uint64_t m_lit_block_version;
+    std::optional<DirtyRegion> m_dirty_region {};
+    bool m_rebuilding_light = false;
+    uint8_t m_uniform_lighting_before = 0;
+    CowVector<uint8_t> m_lighting_data_before {};
 };
\ No newline at end of file
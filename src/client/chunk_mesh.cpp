@@ -1,11 +1,13 @@
 #include "chunk_mesh.hpp"
 
+#include <bit>
+
+#include "block_registry.hpp"
 #include "common.hpp"
 
 #include <nnm/nnm.hpp>
 
-#include "chunk_data.hpp"
-#include "world_data.hpp"
+#include "chunk_neighborhood.hpp"
 #include "world_renderer.hpp"
 
 void combine_mesh_data(ChunkMeshData& data, const ChunkMeshData& other)
@@ -23,14 +25,8 @@ void combine_mesh_data(ChunkMeshData& data, const ChunkMeshData& other)
 }
 
 std::array<uint8_t, 4> calc_chunk_face_lighting(
-    const WorldData& data,
-    const ChunkData& chunk_data,
-    const nnm::Vector3i chunk_pos,
-    const nnm::Vector3i local_block_pos,
-    const Direction dir)
+    const ChunkNeighborhood& neighborhood, const nnm::Vector3i local_block_pos, const Direction dir)
 {
-    const nnm::Vector3i world_pos = block_local_to_world(chunk_pos, local_block_pos);
-
     uint8_t base_lighting = 0;
 
     // format of check_blocks
@@ -42,7 +38,7 @@ std::array<uint8_t, 4> calc_chunk_face_lighting(
     std::array<nnm::Vector3i, 8> check_blocks;
     switch (dir) {
     case Direction::front:
-        base_lighting = data.lighting_at(world_pos + nnm::Vector3i(0, -1, 0)).value();
+        base_lighting = neighborhood.lighting_at(local_block_pos + nnm::Vector3i(0, -1, 0));
         check_blocks[0] = { -1, -1, 1 };
         check_blocks[1] = { 0, -1, 1 };
         check_blocks[2] = { 1, -1, 1 };
@@ -53,7 +49,7 @@ std::array<uint8_t, 4> calc_chunk_face_lighting(
         check_blocks[7] = { -1, -1, 0 };
         break;
     case Direction::back:
-        base_lighting = data.lighting_at(world_pos + nnm::Vector3i(0, 1, 0)).value();
+        base_lighting = neighborhood.lighting_at(local_block_pos + nnm::Vector3i(0, 1, 0));
         check_blocks[0] = { 1, 1, 1 };
         check_blocks[1] = { 0, 1, 1 };
         check_blocks[2] = { -1, 1, 1 };
@@ -64,7 +60,7 @@ std::array<uint8_t, 4> calc_chunk_face_lighting(
         check_blocks[7] = { 1, 1, 0 };
         break;
     case Direction::left:
-        base_lighting = data.lighting_at(world_pos + nnm::Vector3i(-1, 0, 0)).value();
+        base_lighting = neighborhood.lighting_at(local_block_pos + nnm::Vector3i(-1, 0, 0));
         check_blocks[0] = { -1, 1, 1 };
         check_blocks[1] = { -1, 0, 1 };
         check_blocks[2] = { -1, -1, 1 };
@@ -75,7 +71,7 @@ std::array<uint8_t, 4> calc_chunk_face_lighting(
         check_blocks[7] = { -1, 1, 0 };
         break;
     case Direction::right:
-        base_lighting = data.lighting_at(world_pos + nnm::Vector3i(1, 0, 0)).value();
+        base_lighting = neighborhood.lighting_at(local_block_pos + nnm::Vector3i(1, 0, 0));
         check_blocks[0] = { 1, -1, 1 };
         check_blocks[1] = { 1, 0, 1 };
         check_blocks[2] = { 1, 1, 1 };
@@ -86,7 +82,7 @@ std::array<uint8_t, 4> calc_chunk_face_lighting(
         check_blocks[7] = { 1, -1, 0 };
         break;
     case Direction::top:
-        base_lighting = data.lighting_at(world_pos + nnm::Vector3i(0, 0, 1)).value();
+        base_lighting = neighborhood.lighting_at(local_block_pos + nnm::Vector3i(0, 0, 1));
         check_blocks[0] = { -1, 1, 1 };
         check_blocks[1] = { 0, 1, 1 };
         check_blocks[2] = { 1, 1, 1 };
@@ -97,7 +93,7 @@ std::array<uint8_t, 4> calc_chunk_face_lighting(
         check_blocks[7] = { -1, 0, 1 };
         break;
     case Direction::bottom:
-        base_lighting = data.lighting_at(world_pos + nnm::Vector3i(0, 0, -1)).value();
+        base_lighting = neighborhood.lighting_at(local_block_pos + nnm::Vector3i(0, 0, -1));
         check_blocks[0] = { 1, 1, -1 };
         check_blocks[1] = { 0, 1, -1 };
         check_blocks[2] = { -1, 1, -1 };
@@ -126,57 +122,39 @@ std::array<uint8_t, 4> calc_chunk_face_lighting(
 
     for (int i = 0; i < check_blocks.size(); ++i) {
         const nnm::Vector3i check_block_local = local_block_pos + check_blocks[i];
-        std::optional<uint8_t> check_block;
-        if (is_block_pos_local(check_block_local)) {
-            check_block = chunk_data.get_block(check_block_local);
-        }
-        else {
-            check_block = data.block_at_relative(chunk_pos, check_block_local);
-        }
-        if (!check_block.has_value()) {
-            continue;
-        }
-        if (is_transparent(*check_block)) {
-            std::optional<uint8_t> block_light;
-            if (is_block_pos_local(check_block_local)) {
-                block_light = chunk_data.lighting_at(check_block_local);
-            }
-            else {
-                block_light = data.lighting_at_relative(chunk_pos, check_block_local);
-            }
-            if (block_light.has_value()) {
-                switch (i) {
-                case 0:
-                    adj_light[0][0] = *block_light;
-                    break;
-                case 1:
-                    adj_light[0][1] = *block_light;
-                    adj_light[1][0] = *block_light;
-                    break;
-                case 2:
-                    adj_light[1][1] = *block_light;
-                    break;
-                case 3:
-                    adj_light[1][3] = *block_light;
-                    adj_light[2][1] = *block_light;
-                    break;
-                case 4:
-                    adj_light[2][3] = *block_light;
-                    break;
-                case 5:
-                    adj_light[2][2] = *block_light;
-                    adj_light[3][3] = *block_light;
-                    break;
-                case 6:
-                    adj_light[3][2] = *block_light;
-                    break;
-                case 7:
-                    adj_light[0][2] = *block_light;
-                    adj_light[3][0] = *block_light;
-                    break;
-                default:
-                    VV_REL_ASSERT(false, "Unreachable")
-                }
+        if (neighborhood.is_transparent_at(check_block_local)) {
+            const uint8_t block_light = neighborhood.lighting_at(check_block_local);
+            switch (i) {
+            case 0:
+                adj_light[0][0] = block_light;
+                break;
+            case 1:
+                adj_light[0][1] = block_light;
+                adj_light[1][0] = block_light;
+                break;
+            case 2:
+                adj_light[1][1] = block_light;
+                break;
+            case 3:
+                adj_light[1][3] = block_light;
+                adj_light[2][1] = block_light;
+                break;
+            case 4:
+                adj_light[2][3] = block_light;
+                break;
+            case 5:
+                adj_light[2][2] = block_light;
+                adj_light[3][3] = block_light;
+                break;
+            case 6:
+                adj_light[3][2] = block_light;
+                break;
+            case 7:
+                adj_light[0][2] = block_light;
+                adj_light[3][0] = block_light;
+                break;
+            default:
+                VV_REL_ASSERT(false, "Unreachable")
             }
         }
     }
@@ -201,20 +179,9 @@ std::array<uint8_t, 4> calc_chunk_face_lighting(
             avg_light_opts(adj_light[3]) };
 
     for (int i = 0; i < check_blocks.size(); i++) {
-        const nnm::Vector3i check_block_local = local_block_pos + check_blocks[i];
-        std::optional<uint8_t> check_block;
-        if (is_block_pos_local(check_block_local)) {
-            check_block = chunk_data.get_block(check_block_local);
-        }
-        else {
-            check_block = data.block_at_relative(chunk_pos, check_block_local);
-        }
-        if (!check_block.has_value()) {
-            continue;
-        }
         constexpr float occlusion_factor = 0.8f;
         static_assert(255 - static_cast<int>(occlusion_factor) * 3 > 0);
-        if (check_block.value() != 0) {
+        if (neighborhood.block_at(local_block_pos + check_blocks[i]) != 0) {
             switch (i) {
             case 0:
                 lighting[0] = static_cast<uint8_t>(static_cast<float>(lighting[0]) * occlusion_factor);
@@ -260,42 +227,42 @@ ChunkFaceData create_chunk_face_mesh(
     QuadUVs uvs;
     switch (face) {
     case Direction::front:
-        uvs = uvs_from_atlas({ 4, 4 }, block_uv(block_type, Direction::front));
+        uvs = uvs_from_atlas(block_atlas_size(), block_uv(block_type, Direction::front));
         data.vertices[0] = nnm::Vector3(-0.5f, -0.5f, 0.5f) + offset;
         data.vertices[1] = nnm::Vector3(0.5f, -0.5f, 0.5f) + offset;
         data.vertices[2] = nnm::Vector3(0.5f, -0.5f, -0.5f) + offset;
         data.vertices[3] = nnm::Vector3(-0.5f, -0.5f, -0.5f) + offset;
         break;
     case Direction::back:
-        uvs = uvs_from_atlas({ 4, 4 }, block_uv(block_type, Direction::back));
+        uvs = uvs_from_atlas(block_atlas_size(), block_uv(block_type, Direction::back));
         data.vertices[0] = nnm::Vector3(0.5f, 0.5f, 0.5f) + offset;
         data.vertices[1] = nnm::Vector3(-0.5f, 0.5f, 0.5f) + offset;
         data.vertices[2] = nnm::Vector3(-0.5f, 0.5f, -0.5f) + offset;
         data.vertices[3] = nnm::Vector3(0.5f, 0.5f, -0.5f) + offset;
         break;
     case Direction::left:
-        uvs = uvs_from_atlas({ 4, 4 }, block_uv(block_type, Direction::left));
+        uvs = uvs_from_atlas(block_atlas_size(), block_uv(block_type, Direction::left));
         data.vertices[0] = nnm::Vector3(-0.5f, 0.5f, 0.5f) + offset;
         data.vertices[1] = nnm::Vector3(-0.5f, -0.5f, 0.5f) + offset;
         data.vertices[2] = nnm::Vector3(-0.5f, -0.5f, -0.5f) + offset;
         data.vertices[3] = nnm::Vector3(-0.5f, 0.5f, -0.5f) + offset;
         break;
     case Direction::right:
-        uvs = uvs_from_atlas({ 4, 4 }, block_uv(block_type, Direction::right));
+        uvs = uvs_from_atlas(block_atlas_size(), block_uv(block_type, Direction::right));
         data.vertices[0] = nnm::Vector3(0.5f, -0.5f, 0.5f) + offset;
         data.vertices[1] = nnm::Vector3(0.5f, 0.5f, 0.5f) + offset;
         data.vertices[2] = nnm::Vector3(0.5f, 0.5f, -0.5f) + offset;
         data.vertices[3] = nnm::Vector3(0.5f, -0.5f, -0.5f) + offset;
         break;
     case Direction::top:
-        uvs = uvs_from_atlas({ 4, 4 }, block_uv(block_type, Direction::top));
+        uvs = uvs_from_atlas(block_atlas_size(), block_uv(block_type, Direction::top));
         data.vertices[0] = nnm::Vector3(-0.5f, 0.5f, 0.5f) + offset;
         data.vertices[1] = nnm::Vector3(0.5f, 0.5f, 0.5f) + offset;
         data.vertices[2] = nnm::Vector3(0.5f, -0.5f, 0.5f) + offset;
         data.vertices[3] = nnm::Vector3(-0.5f, -0.5f, 0.5f) + offset;
         break;
     case Direction::bottom:
-        uvs = uvs_from_atlas({ 4, 4 }, block_uv(block_type, Direction::bottom));
+        uvs = uvs_from_atlas(block_atlas_size(), block_uv(block_type, Direction::bottom));
         data.vertices[0] = nnm::Vector3(0.5f, 0.5f, -0.5f) + offset;
         data.vertices[1] = nnm::Vector3(-0.5f, 0.5f, -0.5f) + offset;
         data.vertices[2] = nnm::Vector3(-0.5f, -0.5f, -0.5f) + offset;
@@ -339,89 +306,36 @@ void add_face_to_mesh(ChunkMeshData& data, const ChunkFaceData& face)
     }
 }
 
-void calc_chunk_block_faces(
-    const uint8_t block_type,
-    ChunkMeshData& mesh,
-    const WorldData& world_data,
-    const ChunkData& chunk_data,
-    const nnm::Vector3i chunk_pos,
-    const nnm::Vector3i local_pos,
-    const bool iterate_empty,
-    const std::array<bool, 6>& directions = { true, true, true, true, true, true })
+std::optional<ChunkBufferData> create_chunk_buffer_data(const ChunkNeighborhood& neighborhood)
 {
-    for (int f = 0; f < 6; f++) {
-        if (!directions[f]) {
-            continue;
-        }
-        const auto dir = static_cast<Direction>(f);
-        const nnm::Vector3i adj_local_pos = local_pos + direction_vector(dir);
-        std::optional<uint8_t> adj_block;
-        if (is_block_pos_local(adj_local_pos)) {
-            adj_block = chunk_data.get_block(adj_local_pos);
-        }
-        else {
-            adj_block = world_data.block_at(block_local_to_world(chunk_pos, adj_local_pos));
-        }
-        uint8_t adj_block_type = 0;
-        if (adj_block.has_value()) {
-            adj_block_type = *adj_block;
-        }
-        if (iterate_empty) {
-            if (adj_block_type != 0 && is_block_pos_local(adj_local_pos)) {
-                std::array<uint8_t, 4> face_lighting = calc_chunk_face_lighting(
-                    world_data, chunk_data, chunk_pos, adj_local_pos, opposite_direction(dir));
-                ChunkFaceData face = create_chunk_face_mesh(
-                    adj_block_type, nnm::Vector3f(adj_local_pos), opposite_direction(dir), face_lighting);
-                add_face_to_mesh(mesh, face);
-            }
-        }
-        else {
-            if (adj_block_type == 0 || is_transparent(adj_block_type)) {
-                std::array<uint8_t, 4> face_lighting
-                    = calc_chunk_face_lighting(world_data, chunk_data, chunk_pos, local_pos, dir);
-                ChunkFaceData face = create_chunk_face_mesh(block_type, nnm::Vector3f(local_pos), dir, face_lighting);
-                add_face_to_mesh(mesh, face);
-            }
-        }
+    if (neighborhood.block_count() == 0) {
+        return {};
     }
-}
-
-std::optional<ChunkBufferData> create_chunk_buffer_data(const nnm::Vector3i chunk_pos, const WorldData& world_data)
-{
+    const nnm::Vector3i chunk_pos = neighborhood.chunk_pos();
     ChunkMeshData mesh;
-    const ChunkData& chunk_data = world_data.chunk_data_at(chunk_pos);
-    for_3d({ 0, 0, 0 }, { 16, 16, 16 }, [&](const nnm::Vector3i local_pos) {
-        const uint8_t block = chunk_data.get_block(local_pos);
-        if (chunk_data.block_count() > 8 * 8 * 8) {
-            if (block != 0) {
-                std::array<bool, 6> directions {};
-                if (local_pos.x == 0) {
-                    directions[static_cast<size_t>(Direction::left)] = true;
-                }
-                if (local_pos.x == 15) {
-                    directions[static_cast<size_t>(Direction::right)] = true;
-                }
-                if (local_pos.y == 0) {
-                    directions[static_cast<size_t>(Direction::front)] = true;
-                }
-                if (local_pos.y == 15) {
-                    directions[static_cast<size_t>(Direction::back)] = true;
-                }
-                if (local_pos.z == 0) {
-                    directions[static_cast<size_t>(Direction::bottom)] = true;
-                }
-                if (local_pos.z == 15) {
-                    directions[static_cast<size_t>(Direction::top)] = true;
-                }
-                calc_chunk_block_faces(block, mesh, world_data, chunk_data, chunk_pos, local_pos, false, directions);
-            }
-            if (block == 0 || is_transparent(block)) {
-                calc_chunk_block_faces(block, mesh, world_data, chunk_data, chunk_pos, local_pos, true);
-            }
+    // A face is visible where a non-air block touches a voxel that shows through, found a whole row at a time
+    for_2d({ 0, 0 }, { 16, 16 }, [&](const nnm::Vector2i row) {
+        const int y = row.x;
+        const int z = row.y;
+        const uint32_t solid = neighborhood.solid_row(y, z) & ChunkNeighborhood::sc_inner_row;
+        if (solid == 0) {
+            return;
         }
-        else {
-            if (block != 0) {
-                calc_chunk_block_faces(block, mesh, world_data, chunk_data, chunk_pos, local_pos, false);
+        std::array<uint32_t, 6> visible {};
+        visible[static_cast<size_t>(Direction::front)] = solid & neighborhood.transparent_row(y - 1, z);
+        visible[static_cast<size_t>(Direction::back)] = solid & neighborhood.transparent_row(y + 1, z);
+        visible[static_cast<size_t>(Direction::left)] = solid & neighborhood.transparent_row(y, z) << 1;
+        visible[static_cast<size_t>(Direction::right)] = solid & neighborhood.transparent_row(y, z) >> 1;
+        visible[static_cast<size_t>(Direction::top)] = solid & neighborhood.transparent_row(y, z + 1);
+        visible[static_cast<size_t>(Direction::bottom)] = solid & neighborhood.transparent_row(y, z - 1);
+        for (int f = 0; f < 6; ++f) {
+            const auto dir = static_cast<Direction>(f);
+            for (uint32_t bits = visible[f]; bits != 0; bits &= bits - 1) {
+                const nnm::Vector3i local_pos { std::countr_zero(bits) - 1, y, z };
+                const std::array<uint8_t, 4> face_lighting = calc_chunk_face_lighting(neighborhood, local_pos, dir);
+                const ChunkFaceData face = create_chunk_face_mesh(
+                    neighborhood.block_at(local_pos), nnm::Vector3f(local_pos), dir, face_lighting);
+                add_face_to_mesh(mesh, face);
             }
         }
     });
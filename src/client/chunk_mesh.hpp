@@ -8,7 +8,8 @@
 
 #include <mve/renderer.hpp>
 
-class WorldData;
+class ChunkNeighborhood;
+
 struct ChunkFaceData {
     std::array<nnm::Vector3f, 4> vertices;
     std::array<nnm::Vector3f, 4> colors;
@@ -55,4 +56,4 @@ private:
     mve::IndexBuffer m_index_buffer;
 };
 
-std::optional<ChunkBufferData> create_chunk_buffer_data(nnm::Vector3i chunk_pos, const WorldData& world_data);
\ No newline at end of file
+std::optional<ChunkBufferData> create_chunk_buffer_data(const ChunkNeighborhood& neighborhood);
\ No newline at end of file
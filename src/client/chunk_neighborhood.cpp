@@ -0,0 +1,81 @@
+#include "chunk_neighborhood.hpp"
+
+// Range of section local coordinates that lands inside the padded volume for one axis of a section offset
+static std::pair<int, int> overlap_range(const int offset)
+{
+    switch (offset) {
+    case -1:
+        return { 15, 16 };
+    case 0:
+        return { 0, 16 };
+    case 1:
+        return { 0, 1 };
+    default:
+        VV_REL_ASSERT(false, "[ChunkNeighborhood] Invalid section offset")
+        return { 0, 0 };
+    }
+}
+
+// Moves the part of a 16 bit section row that overlaps the padded volume to its padded bit positions
+static uint32_t padded_row_bits(const int offset, const uint16_t row)
+{
+    switch (offset) {
+    case -1:
+        return row >> 15 & 1;
+    case 0:
+        return static_cast<uint32_t>(row) << 1;
+    case 1:
+        return (row & 1u) << 17;
+    default:
+        VV_REL_ASSERT(false, "[ChunkNeighborhood] Invalid section offset")
+        return 0;
+    }
+}
+
+void ChunkNeighborhood::copy_section(const nnm::Vector3i offset, const ChunkData& chunk)
+{
+    if (offset == nnm::Vector3i::zero()) {
+        m_block_count = chunk.block_count();
+    }
+    if (chunk.is_uniform()) {
+        fill_section(offset, chunk.get_block({ 0, 0, 0 }), chunk.packed_light_at({ 0, 0, 0 }));
+        return;
+    }
+    const auto [min_x, max_x] = overlap_range(offset.x);
+    const auto [min_y, max_y] = overlap_range(offset.y);
+    const auto [min_z, max_z] = overlap_range(offset.z);
+    const uint32_t keep_mask = ~padded_row_bits(offset.x, 0xFFFF);
+    for (int z = min_z; z < max_z; ++z) {
+        for (int y = min_y; y < max_y; ++y) {
+            const int row = row_index(y + offset.y * 16, z + offset.z * 16);
+            m_solid_rows[row] = m_solid_rows[row] & keep_mask | padded_row_bits(offset.x, chunk.solid_row(y, z));
+            m_transparent_rows[row]
+                = m_transparent_rows[row] & keep_mask | padded_row_bits(offset.x, chunk.transparent_row(y, z));
+            int i = index(nnm::Vector3i(min_x, y, z) + offset * 16);
+            for (int x = min_x; x < max_x; ++x, ++i) {
+                m_blocks[i] = chunk.get_block({ x, y, z });
+                m_light[i] = chunk.packed_light_at({ x, y, z });
+            }
+        }
+    }
+}
+
+void ChunkNeighborhood::fill_section(const nnm::Vector3i offset, const uint8_t block, const uint8_t packed_light)
+{
+    const auto [min_x, max_x] = overlap_range(offset.x);
+    const auto [min_y, max_y] = overlap_range(offset.y);
+    const auto [min_z, max_z] = overlap_range(offset.z);
+    const uint32_t fill_mask = padded_row_bits(offset.x, 0xFFFF);
+    const uint32_t solid_bits = block != 0 ? fill_mask : 0;
+    const uint32_t transparent_bits = is_transparent(block) ? fill_mask : 0;
+    for (int z = min_z; z < max_z; ++z) {
+        for (int y = min_y; y < max_y; ++y) {
+            const int row = row_index(y + offset.y * 16, z + offset.z * 16);
+            m_solid_rows[row] = m_solid_rows[row] & ~fill_mask | solid_bits;
+            m_transparent_rows[row] = m_transparent_rows[row] & ~fill_mask | transparent_bits;
+            const int i = index(nnm::Vector3i(min_x, y, z) + offset * 16);
+            std::fill_n(m_blocks.begin() + i, max_x - min_x, block);
+            std::fill_n(m_light.begin() + i, max_x - min_x, packed_light);
+        }
+    }
+}
\ No newline at end of file
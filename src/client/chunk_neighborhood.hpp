@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "common.hpp"
+
+#include <nnm/nnm.hpp>
+
+#include "chunk_data.hpp"
+
+// Copy of one section plus a one voxel border taken from its 26 neighbours. Local positions run from -1 to 16 on
+// each axis, so kernels can read across section borders without going back to the world and worker threads get an
+// input that nothing else writes to.
+class ChunkNeighborhood {
+public:
+    static constexpr int sc_size = 18;
+    static constexpr int sc_volume = sc_size * sc_size * sc_size;
+    static constexpr int sc_stride_y = sc_size;
+    static constexpr int sc_stride_z = sc_size * sc_size;
+    // Row bits of the section itself, bit 0 and bit 17 are the border
+    static constexpr uint32_t sc_inner_row = 0xFFFF << 1;
+
+    static int index(const nnm::Vector3i local_pos)
+    {
+        return local_pos.x + 1 + (local_pos.y + 1) * sc_stride_y + (local_pos.z + 1) * sc_stride_z;
+    }
+
+    [[nodiscard]] nnm::Vector3i chunk_pos() const
+    {
+        return m_chunk_pos;
+    }
+
+    // Non-air blocks in the center section
+    [[nodiscard]] int block_count() const
+    {
+        return m_block_count;
+    }
+
+    [[nodiscard]] uint8_t block_at(const nnm::Vector3i local_pos) const
+    {
+        VV_DEB_ASSERT(is_padded_pos(local_pos), "[ChunkNeighborhood] Invalid padded position");
+        return m_blocks[index(local_pos)];
+    }
+
+    [[nodiscard]] uint8_t light_at(const nnm::Vector3i local_pos, const LightChannel channel) const
+    {
+        VV_DEB_ASSERT(is_padded_pos(local_pos), "[ChunkNeighborhood] Invalid padded position");
+        return m_light[index(local_pos)] >> static_cast<int>(channel) & 0x0F;
+    }
+
+    [[nodiscard]] uint8_t lighting_at(const nnm::Vector3i local_pos) const
+    {
+        VV_DEB_ASSERT(is_padded_pos(local_pos), "[ChunkNeighborhood] Invalid padded position");
+        const uint8_t packed = m_light[index(local_pos)];
+        return std::max<uint8_t>(packed >> 4, packed & 0x0F);
+    }
+
+    // Bit x + 1 of a row is set when the voxel at (x, y, z) is not air
+    [[nodiscard]] uint32_t solid_row(const int y, const int z) const
+    {
+        return m_solid_rows[row_index(y, z)];
+    }
+
+    // Bit x + 1 of a row is set when light and neighbouring faces show through the voxel at (x, y, z)
+    [[nodiscard]] uint32_t transparent_row(const int y, const int z) const
+    {
+        return m_transparent_rows[row_index(y, z)];
+    }
+
+    [[nodiscard]] bool is_transparent_at(const nnm::Vector3i local_pos) const
+    {
+        VV_DEB_ASSERT(is_padded_pos(local_pos), "[ChunkNeighborhood] Invalid padded position");
+        return transparent_row(local_pos.y, local_pos.z) >> (local_pos.x + 1) & 1;
+    }
+
+    void set_chunk_pos(const nnm::Vector3i chunk_pos)
+    {
+        m_chunk_pos = chunk_pos;
+        m_block_count = 0;
+    }
+
+    // Copies the part of the section at the given offset (-1 to 1 on each axis) that overlaps the padded volume
+    void copy_section(nnm::Vector3i offset, const ChunkData& chunk);
+
+    void fill_section(nnm::Vector3i offset, uint8_t block, uint8_t packed_light);
+
+private:
+    static int row_index(const int y, const int z)
+    {
+        VV_DEB_ASSERT(y >= -1 && y <= 16 && z >= -1 && z <= 16, "[ChunkNeighborhood] Invalid padded row");
+        return y + 1 + (z + 1) * sc_size;
+    }
+
+    static bool is_padded_pos(const nnm::Vector3i local_pos)
+    {
+        return local_pos.x >= -1 && local_pos.x <= 16 && local_pos.y >= -1 && local_pos.y <= 16 && local_pos.z >= -1
+            && local_pos.z <= 16;
+    }
+
+    nnm::Vector3i m_chunk_pos;
+    int m_block_count = 0;
+    std::array<uint8_t, sc_volume> m_blocks {};
+    std::array<uint8_t, sc_volume> m_light {};
+    std::array<uint32_t, sc_size * sc_size> m_solid_rows {};
+    std::array<uint32_t, sc_size * sc_size> m_transparent_rows {};
+};
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "column_cache.hpp"
+
+#include <lz4.h>
+
+#include "../common/assert.hpp"
+
+void ColumnCache::insert(const nnm::Vector2i pos, const std::string_view data)
+{
+    if (const auto it = m_entries.find(pos); it != m_entries.end()) {
+        erase(it);
+    }
+    std::string compressed(LZ4_compressBound(static_cast<int>(data.size())), '\0');
+    const int compressed_size = LZ4_compress_default(
+        data.data(), compressed.data(), static_cast<int>(data.size()), static_cast<int>(compressed.size()));
+    VV_REL_ASSERT(compressed_size > 0, "[ColumnCache] LZ4 compression error")
+    compressed.resize(compressed_size);
+    compressed.shrink_to_fit();
+    m_memory_usage += compressed.capacity() + sc_entry_overhead;
+    const auto order = m_order.insert(m_order.end(), pos);
+    m_entries.insert(
+        { pos, Entry { .decompressed_size = data.size(), .compressed = std::move(compressed), .order = order } });
+    evict_to_budget();
+}
+
+std::optional<std::string> ColumnCache::take(const nnm::Vector2i pos)
+{
+    const auto it = m_entries.find(pos);
+    if (it == m_entries.end()) {
+        return {};
+    }
+    const Entry& entry = it->second;
+    std::string data(entry.decompressed_size, '\0');
+    const int result_size = LZ4_decompress_safe(
+        entry.compressed.data(),
+        data.data(),
+        static_cast<int>(entry.compressed.size()),
+        static_cast<int>(data.size()));
+    VV_REL_ASSERT(result_size == static_cast<int>(data.size()), "[ColumnCache] LZ4 decompression error")
+    erase(it);
+    return data;
+}
+
+void ColumnCache::set_budget(const size_t bytes)
+{
+    m_budget = bytes;
+    evict_to_budget();
+}
+
+void ColumnCache::erase(const std::unordered_map<nnm::Vector2i, Entry>::iterator entry)
+{
+    m_memory_usage -= entry->second.compressed.capacity() + sc_entry_overhead;
+    m_order.erase(entry->second.order);
+    m_entries.erase(entry);
+}
+
+void ColumnCache::evict_to_budget()
+{
+    while (m_memory_usage > m_budget && !m_order.empty()) {
+        erase(m_entries.find(m_order.front()));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "common.hpp"
+
+#include <nnm/nnm.hpp>
+
+// Serialized columns kept LZ4 compressed in memory, between the resident columns and the save. Entries are copies of
+// what a column held when it was evicted, which WorldData saves first if it changed, so dropping one never loses
+// anything. Past the byte budget the least recently inserted entries are dropped first.
+class ColumnCache {
+public:
+    void insert(nnm::Vector2i pos, std::string_view data);
+
+    // Removes the entry, the column is resident again from here on
+    [[nodiscard]] std::optional<std::string> take(nnm::Vector2i pos);
+
+    [[nodiscard]] bool contains(const nnm::Vector2i pos) const
+    {
+        return m_entries.contains(pos);
+    }
+
+    void set_budget(size_t bytes);
+
+    [[nodiscard]] size_t budget() const
+    {
+        return m_budget;
+    }
+
+    // Compressed bytes plus bookkeeping
+    [[nodiscard]] size_t memory_usage() const
+    {
+        return m_memory_usage;
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_entries.size();
+    }
+
+private:
+    static constexpr size_t sc_default_budget = size_t { 64 } * 1024 * 1024;
+    // Map node, list node and string header, roughly
+    static constexpr size_t sc_entry_overhead = 96;
+
+    struct Entry {
+        size_t decompressed_size;
+        std::string compressed;
+        std::list<nnm::Vector2i>::iterator order;
+    };
+
+    void erase(std::unordered_map<nnm::Vector2i, Entry>::iterator entry);
+
+    void evict_to_budget();
+
+    std::unordered_map<nnm::Vector2i, Entry> m_entries {};
+    // Oldest first
+    std::list<nnm::Vector2i> m_order {};
+    size_t m_memory_usage = 0;
+    size_t m_budget = sc_default_budget;
+};
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "column_codec.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include "binary_archive.hpp"
+#include "chunk_column.hpp"
+
+// Sorts after every key cereal writes, which all start with its endianness flag
+static constexpr char sc_column_key_tag = 'c';
+static constexpr size_t sc_column_key_size = 1 + sizeof(uint64_t);
+static constexpr size_t sc_section_key_size = sc_column_key_size + sizeof(uint32_t);
+
+// Columns as the first versions saved them, before sections were palette packed and allocated sparsely: 20 sections
+// from height -10, each a position, a byte per voxel for the block and another for the light, and its block count
+static constexpr int sc_fixed_sections = 20;
+static constexpr int sc_fixed_min_height = -10;
+static constexpr int sc_fixed_section_volume = 16 * 16 * 16;
+static constexpr size_t sc_fixed_section_size = 3 * sizeof(int32_t) + 2 * sc_fixed_section_volume + sizeof(int32_t);
+static constexpr size_t sc_fixed_column_size
+    = 1 + 2 * sizeof(int32_t) + sc_fixed_sections * sc_fixed_section_size + sizeof(uint32_t);
+
+static uint64_t spread_bits(const uint32_t value)
+{
+    uint64_t bits = value;
+    bits = (bits | bits << 16) & 0x0000FFFF0000FFFF;
+    bits = (bits | bits << 8) & 0x00FF00FF00FF00FF;
+    bits = (bits | bits << 4) & 0x0F0F0F0F0F0F0F0F;
+    bits = (bits | bits << 2) & 0x3333333333333333;
+    bits = (bits | bits << 1) & 0x5555555555555555;
+    return bits;
+}
+
+static uint32_t compact_bits(uint64_t bits)
+{
+    bits &= 0x5555555555555555;
+    bits = (bits | bits >> 1) & 0x3333333333333333;
+    bits = (bits | bits >> 2) & 0x0F0F0F0F0F0F0F0F;
+    bits = (bits | bits >> 4) & 0x00FF00FF00FF00FF;
+    bits = (bits | bits >> 8) & 0x0000FFFF0000FFFF;
+    bits = (bits | bits >> 16) & 0x00000000FFFFFFFF;
+    return static_cast<uint32_t>(bits);
+}
+
+uint64_t column_morton_code(const nnm::Vector2i pos)
+{
+    constexpr uint32_t bias = 0x80000000;
+    return spread_bits(static_cast<uint32_t>(pos.x) ^ bias) | spread_bits(static_cast<uint32_t>(pos.y) ^ bias) << 1;
+}
+
+nnm::Vector2i column_pos_from_morton_code(const uint64_t code)
+{
+    constexpr uint32_t bias = 0x80000000;
+    return { static_cast<int>(compact_bits(code) ^ bias), static_cast<int>(compact_bits(code >> 1) ^ bias) };
+}
+
+std::string_view encode_column_key(const nnm::Vector2i pos)
+{
+    thread_local std::array<char, sc_column_key_size> key;
+    const uint64_t code = column_morton_code(pos);
+    key[0] = sc_column_key_tag;
+    for (int i = 0; i < 8; ++i) {
+        key[1 + i] = static_cast<char>(code >> (56 - i * 8));
+    }
+    return { key.data(), key.size() };
+}
+
+std::optional<nnm::Vector2i> decode_column_key(const std::string_view key)
+{
+    if (key.size() != sc_column_key_size || key[0] != sc_column_key_tag) {
+        return {};
+    }
+    uint64_t code = 0;
+    for (int i = 0; i < 8; ++i) {
+        code = code << 8 | static_cast<uint8_t>(key[1 + i]);
+    }
+    return column_pos_from_morton_code(code);
+}
+
+std::string_view encode_section_key(const nnm::Vector3i chunk_pos)
+{
+    thread_local std::array<char, sc_section_key_size> key;
+    const std::string_view column_key = encode_column_key({ chunk_pos.x, chunk_pos.y });
+    std::ranges::copy(column_key, key.begin());
+    // Biased like the Morton code so negative heights sort first
+    const uint32_t height = static_cast<uint32_t>(chunk_pos.z) ^ 0x80000000;
+    for (int i = 0; i < 4; ++i) {
+        key[sc_column_key_size + i] = static_cast<char>(height >> (24 - i * 8));
+    }
+    return { key.data(), key.size() };
+}
+
+std::optional<nnm::Vector3i> decode_section_key(const std::string_view key)
+{
+    if (key.size() != sc_section_key_size) {
+        return {};
+    }
+    const std::optional<nnm::Vector2i> pos = decode_column_key(key.substr(0, sc_column_key_size));
+    if (!pos.has_value()) {
+        return {};
+    }
+    uint32_t height = 0;
+    for (int i = 0; i < 4; ++i) {
+        height = height << 8 | static_cast<uint8_t>(key[sc_column_key_size + i]);
+    }
+    return nnm::Vector3i { pos->x, pos->y, static_cast<int>(height ^ 0x80000000) };
+}
+
+std::optional<nnm::Vector2i> decode_legacy_column_key(const std::string_view key)
+{
+    // Other values saved by cereal have longer keys, strings start with an eight byte length
+    if (key.size() != 1 + 2 * sizeof(int32_t) || key[0] != 1) {
+        return {};
+    }
+    nnm::Vector2i pos;
+    BinaryInputArchive archive(key);
+    archive(pos);
+    return pos;
+}
+
+std::string_view encode_column(const ChunkColumn& column)
+{
+    // Keeps the capacity of the largest column encoded on the thread
+    thread_local std::vector<char> buffer;
+    buffer.clear();
+    BinaryOutputArchive archive(buffer);
+    archive(column);
+    return { buffer.data(), buffer.size() };
+}
+
+std::string_view encode_column_header(const ChunkColumn& column)
+{
+    thread_local std::vector<char> buffer;
+    buffer.clear();
+    BinaryOutputArchive archive(buffer);
+    column.save_header(archive);
+    return { buffer.data(), buffer.size() };
+}
+
+std::string_view encode_section(const ChunkData& section)
+{
+    thread_local std::vector<char> buffer;
+    buffer.clear();
+    BinaryOutputArchive archive(buffer);
+    archive(section);
+    return { buffer.data(), buffer.size() };
+}
+
+// Section positions were never set, the fixed layout is told apart by its size, the block count of every section
+// matching its blocks and a valid generation level
+static bool is_fixed_column(const std::string_view data)
+{
+    if (data.size() != sc_fixed_column_size) {
+        return false;
+    }
+    for (int i = 0; i < sc_fixed_sections; ++i) {
+        const char* section = data.data() + 1 + 2 * sizeof(int32_t) + i * sc_fixed_section_size;
+        const std::string_view blocks(section + 3 * sizeof(int32_t), sc_fixed_section_volume);
+        int32_t block_count;
+        std::memcpy(&block_count, section + 3 * sizeof(int32_t) + 2 * sc_fixed_section_volume, sizeof(block_count));
+        if (std::ranges::count_if(blocks, [](const char block) { return block != 0; }) != block_count) {
+            return false;
+        }
+    }
+    uint32_t gen_level;
+    std::memcpy(&gen_level, data.data() + data.size() - sizeof(gen_level), sizeof(gen_level));
+    return gen_level <= ChunkColumn::generated;
+}
+
+// Only the blocks are kept, the column is relit when loaded. Sections of air are left out as open sky.
+static void decode_fixed_column(const std::string_view data, ChunkColumn& column)
+{
+    BinaryInputArchive archive(data);
+    nnm::Vector2i pos;
+    archive(pos);
+    VV_REL_ASSERT(pos == column.pos(), "[decode_column] Column saved at another position")
+    std::array<uint8_t, sc_fixed_section_volume> blocks;
+    std::array<uint8_t, sc_fixed_section_volume> lighting;
+    for (int i = 0; i < sc_fixed_sections; ++i) {
+        nnm::Vector3i unset_pos;
+        int32_t block_count;
+        archive(unset_pos, blocks, lighting, block_count);
+        if (block_count == 0) {
+            continue;
+        }
+        ChunkData& section = column.chunk_data_at(sc_fixed_min_height + i);
+        for (int index = 0; index < sc_fixed_section_volume; ++index) {
+            if (blocks[index] != 0) {
+                section.set_block({ index % 16, index / 16 % 16, index / 256 }, blocks[index]);
+            }
+        }
+        section.compact();
+    }
+    uint32_t gen_level;
+    archive(gen_level);
+    column.set_gen_level(static_cast<ChunkColumn::GenLevel>(gen_level));
+}
+
+void decode_column(const std::string_view data, ChunkColumn& column, SavedLayout* layout)
+{
+    if (is_fixed_column(data)) {
+        decode_fixed_column(data, column);
+        // Nothing of it is in the save as it is now
+        if (layout != nullptr) {
+            layout->lit = true;
+        }
+        return;
+    }
+    BinaryInputArchive archive(data);
+    column.load(archive, layout);
+}
+
+void decode_section(const std::string_view data, ChunkColumn& column, const int height, const SavedLayout& layout)
+{
+    ChunkData* section = column.find_chunk_data(height);
+    VV_REL_ASSERT(section != nullptr, "[decode_section] Column has no section at the height")
+    BinaryInputArchive archive(data);
+    if (layout.lit) {
+        section->load_lit(archive);
+    }
+    else {
+        archive(*section);
+    }
+}
\ No newline at end of file
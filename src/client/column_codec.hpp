@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "common.hpp"
+
+#include <nnm/nnm.hpp>
+
+class ChunkColumn;
+class ChunkData;
+struct SavedLayout;
+
+// Columns encoded as cereal's PortableBinary archives would, written and read through the binary archives so nothing
+// goes through streams. Encoded views point into buffers reused by the next call of the same function on the same
+// thread.
+
+// Save keys are a tag byte and the Morton code of the position in big endian, so in LevelDB's byte order columns
+// near each other are mostly near each other in the save too
+[[nodiscard]] std::string_view encode_column_key(nnm::Vector2i pos);
+
+[[nodiscard]] std::optional<nnm::Vector2i> decode_column_key(std::string_view key);
+
+// Sections saved apart from their column are keyed by the column's key followed by the height, so they come right
+// after the column in LevelDB's order, lowest first
+[[nodiscard]] std::string_view encode_section_key(nnm::Vector3i chunk_pos);
+
+[[nodiscard]] std::optional<nnm::Vector3i> decode_section_key(std::string_view key);
+
+// Keys columns were saved under before, cereal's encoding of the position
+[[nodiscard]] std::optional<nnm::Vector2i> decode_legacy_column_key(std::string_view key);
+
+// Bits of x and y interleaved with x lowest, after biasing both to unsigned so the order holds for negative positions
+[[nodiscard]] uint64_t column_morton_code(nnm::Vector2i pos);
+
+[[nodiscard]] nnm::Vector2i column_pos_from_morton_code(uint64_t code);
+
+// The column with its sections and all their light, as the cache keeps columns
+[[nodiscard]] std::string_view encode_column(const ChunkColumn& column);
+
+// The column listing which sections it has, each saved apart with encode_section
+[[nodiscard]] std::string_view encode_column_header(const ChunkColumn& column);
+
+// Without sunlight, which is rebuilt from the blocks on load
+[[nodiscard]] std::string_view encode_section(const ChunkData& section);
+
+// Decodes either encoding of a column, or a column saved by the first versions into an empty one at its position.
+// Sections saved apart are listed in the layout, to be decoded with decode_section, and must not be there if it is
+// null. Columns from the save are left without their sunlight, see relight_loaded_column.
+void decode_column(std::string_view data, ChunkColumn& column, SavedLayout* layout = nullptr);
+
+void decode_section(std::string_view data, ChunkColumn& column, int height, const SavedLayout& layout);
\ No newline at end of file
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <nnm/nnm.hpp>
+
+#include "../common/assert.hpp"
+
+// Columns keyed by position on a square ring buffer, a position lives in the slot at pos mod diameter. The resident
+// set is a disc around the player so slots are reused as it moves instead of allocating nodes. Each slot is tagged
+// with the position it holds to tell it apart from other positions mapping to the same slot. Holders evict stale
+// positions themselves, see occupant, but positions still in use can share a slot for a while, after a teleport or
+// when the render distance grows. An insert landing on a slot held by another position doubles the grid then, up to
+// a fixed limit past which the occupant is replaced, and inserts halve it again once the positions held fit a quarter
+// of the slots of half the diameter.
+// Resizing moves the values and invalidates references into the grid, erasing never does.
+template <typename T>
+class ColumnGrid {
+public:
+    explicit ColumnGrid(const int diameter = sc_initial_diameter)
+        : m_min_diameter(diameter)
+    {
+        VV_DEB_ASSERT(diameter > 0 && (diameter & (diameter - 1)) == 0, "[ColumnGrid] Diameter must be a power of 2")
+        resize(diameter);
+    }
+
+    [[nodiscard]] T* find(const nnm::Vector2i pos)
+    {
+        Slot& slot = m_slots[slot_index(pos)];
+        return slot.value.has_value() && slot.pos == pos ? &*slot.value : nullptr;
+    }
+
+    [[nodiscard]] const T* find(const nnm::Vector2i pos) const
+    {
+        const Slot& slot = m_slots[slot_index(pos)];
+        return slot.value.has_value() && slot.pos == pos ? &*slot.value : nullptr;
+    }
+
+    [[nodiscard]] bool contains(const nnm::Vector2i pos) const
+    {
+        return find(pos) != nullptr;
+    }
+
+    [[nodiscard]] T& at(const nnm::Vector2i pos)
+    {
+        T* value = find(pos);
+        VV_DEB_ASSERT(value != nullptr, "[ColumnGrid] Invalid position")
+        return *value;
+    }
+
+    [[nodiscard]] const T& at(const nnm::Vector2i pos) const
+    {
+        const T* value = find(pos);
+        VV_DEB_ASSERT(value != nullptr, "[ColumnGrid] Invalid position")
+        return *value;
+    }
+
+    // Position held in the slot the given position maps to, inserting the given position while another one is held
+    // there grows the grid, evicting it first keeps the grid at its size
+    [[nodiscard]] std::optional<nnm::Vector2i> occupant(const nnm::Vector2i pos) const
+    {
+        const Slot& slot = m_slots[slot_index(pos)];
+        return slot.value.has_value() ? std::optional(slot.pos) : std::nullopt;
+    }
+
+    // Returns the value at the position and whether it was inserted, existing values are left alone
+    template <typename... Args>
+    std::pair<T*, bool> try_emplace(const nnm::Vector2i pos, Args&&... args)
+    {
+        if (T* value = find(pos); value != nullptr) {
+            return { value, false };
+        }
+        if (m_diameter > m_min_diameter && m_size < m_shrink_size) {
+            // A position left far away can keep the others from fitting, checking again is put off for as many
+            // inserts as the check visits slots over sixteen
+            if (m_shrink_delay > 0) {
+                m_shrink_delay--;
+            }
+            else if (fits(m_diameter / 2, pos)) {
+                resize(m_diameter / 2);
+            }
+            else {
+                m_shrink_delay = m_shrink_size;
+            }
+        }
+        while (m_slots[slot_index(pos)].value.has_value() && m_diameter < sc_max_diameter) {
+            resize(m_diameter * 2);
+        }
+        Slot& slot = m_slots[slot_index(pos)];
+        // Holders evict stale positions before inserting, past the limit the occupant is one of them and replaced
+        VV_DEB_ASSERT(!slot.value.has_value(), "[ColumnGrid] Positions held too far apart")
+        if (!slot.value.has_value()) {
+            m_size++;
+        }
+        slot.pos = pos;
+        slot.value.emplace(std::forward<Args>(args)...);
+        return { &*slot.value, true };
+    }
+
+    bool erase(const nnm::Vector2i pos)
+    {
+        Slot& slot = m_slots[slot_index(pos)];
+        if (!slot.value.has_value() || slot.pos != pos) {
+            return false;
+        }
+        slot.value.reset();
+        m_size--;
+        return true;
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_size;
+    }
+
+    [[nodiscard]] int diameter() const
+    {
+        return m_diameter;
+    }
+
+    // Visits in slot order, the callable must not insert
+    template <typename Callable>
+    void for_each(Callable callable)
+    {
+        for (Slot& slot : m_slots) {
+            if (slot.value.has_value()) {
+                std::invoke(callable, slot.pos, *slot.value);
+            }
+        }
+    }
+
+    template <typename Callable>
+    void for_each(Callable callable) const
+    {
+        for (const Slot& slot : m_slots) {
+            if (slot.value.has_value()) {
+                std::invoke(callable, slot.pos, *slot.value);
+            }
+        }
+    }
+
+private:
+    static constexpr int sc_initial_diameter = 64;
+    // 16 times the initial slots, a disc of columns this wide is well past any render distance
+    static constexpr int sc_max_diameter = 1024;
+
+    struct Slot {
+        nnm::Vector2i pos;
+        std::optional<T> value;
+    };
+
+    [[nodiscard]] size_t slot_index(const nnm::Vector2i pos) const
+    {
+        // Power of 2 diameter, masking is a floored modulo for negative positions too
+        return static_cast<size_t>((pos.y & m_mask) * m_diameter + (pos.x & m_mask));
+    }
+
+    // Whether the positions held and the given one would each have a slot of their own at the diameter
+    [[nodiscard]] bool fits(const int diameter, const nnm::Vector2i pos) const
+    {
+        const int mask = diameter - 1;
+        std::vector<bool> taken(static_cast<size_t>(diameter) * diameter);
+        const auto take = [&](const nnm::Vector2i held) {
+            const size_t index = static_cast<size_t>((held.y & mask) * diameter + (held.x & mask));
+            if (taken[index]) {
+                return false;
+            }
+            taken[index] = true;
+            return true;
+        };
+        if (!take(pos)) {
+            return false;
+        }
+        for (const Slot& slot : m_slots) {
+            if (slot.value.has_value() && !take(slot.pos)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void resize(const int diameter)
+    {
+        std::vector<Slot> prev = std::move(m_slots);
+        m_diameter = diameter;
+        m_mask = diameter - 1;
+        m_slots = std::vector<Slot>(static_cast<size_t>(diameter) * diameter);
+        // Positions in different slots mod d are in different slots mod 2d, halving is only done when nothing
+        // collides either
+        for (Slot& slot : prev) {
+            if (slot.value.has_value()) {
+                Slot& moved = m_slots[slot_index(slot.pos)];
+                VV_DEB_ASSERT(!moved.value.has_value(), "[ColumnGrid] Positions collide after resizing")
+                moved.pos = slot.pos;
+                moved.value = std::move(slot.value);
+            }
+        }
+        m_shrink_size = static_cast<size_t>(diameter / 2) * (diameter / 2) / 4;
+        m_shrink_delay = 0;
+    }
+
+    int m_min_diameter;
+    size_t m_shrink_size = 0;
+    size_t m_shrink_delay = 0;
+    int m_diameter = 0;
+    int m_mask = 0;
+    std::vector<Slot> m_slots {};
+    size_t m_size = 0;
+};
\ No newline at end of file
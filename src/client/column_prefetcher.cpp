@@ -0,0 +1,97 @@
+#include "column_prefetcher.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "column_store.hpp"
+#include "save_file.hpp"
+
+ColumnPrefetcher::ColumnPrefetcher(SaveFile& save)
+    : m_save(&save)
+    , m_thread([this] { run(); })
+{
+}
+
+ColumnPrefetcher::~ColumnPrefetcher()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+        m_queued.clear();
+    }
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+void ColumnPrefetcher::request(const std::vector<nnm::Vector2i>& positions)
+{
+    const std::unordered_set<nnm::Vector2i> requested(positions.begin(), positions.end());
+    {
+        std::lock_guard lock(m_mutex);
+        std::erase_if(m_ready, [&](const auto& entry) { return !requested.contains(entry.first); });
+        m_queued.clear();
+        for (const nnm::Vector2i pos : positions) {
+            if (!m_ready.contains(pos) && m_decoding != pos) {
+                m_queued.push_back(pos);
+            }
+        }
+    }
+    m_condition.notify_all();
+}
+
+bool ColumnPrefetcher::take(
+    const nnm::Vector2i pos, std::optional<ChunkColumn>& column, std::vector<int>& unsaved_heights)
+{
+    std::unique_lock lock(m_mutex);
+    m_condition.wait(lock, [&] { return m_decoding != pos; });
+    if (const auto it = m_ready.find(pos); it != m_ready.end()) {
+        column = std::move(it->second.column);
+        unsaved_heights = std::move(it->second.unsaved_heights);
+        m_ready.erase(it);
+        return true;
+    }
+    if (const auto it = std::ranges::find(m_queued, pos); it != m_queued.end()) {
+        m_queued.erase(it);
+    }
+    return false;
+}
+
+bool ColumnPrefetcher::is_ready(const nnm::Vector2i pos) const
+{
+    std::lock_guard lock(m_mutex);
+    return m_ready.contains(pos);
+}
+
+size_t ColumnPrefetcher::ready_count() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_ready.size();
+}
+
+void ColumnPrefetcher::run()
+{
+    while (true) {
+        nnm::Vector2i pos;
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [&] { return m_stopping || !m_queued.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            pos = m_queued.front();
+            m_queued.pop_front();
+            m_decoding = pos;
+        }
+        // Unpooled, the pool belongs to the main thread and is handed over when the column is taken
+        Prefetched prefetched { std::optional<ChunkColumn>(std::in_place, pos), {} };
+        if (!load_column(*m_save, pos, *prefetched.column, prefetched.unsaved_heights)) {
+            prefetched.column.reset();
+        }
+        {
+            std::lock_guard lock(m_mutex);
+            m_ready.insert_or_assign(pos, std::move(prefetched));
+            m_decoding.reset();
+        }
+        m_condition.notify_all();
+    }
+}
\ No newline at end of file
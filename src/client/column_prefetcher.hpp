@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+
+#include <nnm/nnm.hpp>
+
+#include "chunk_column.hpp"
+
+class SaveFile;
+
+// Reads, decodes and relights columns from the save on its own thread before the main thread asks for them. Requests
+// are worked through in the order given and replaced as a whole, decoded columns wait until taken or no longer
+// requested. Only columns whose saved data cannot change before they are taken may be requested, so columns that are
+// resident, cached or still being written are left to the main thread.
+class ColumnPrefetcher {
+public:
+    explicit ColumnPrefetcher(SaveFile& save);
+
+    ColumnPrefetcher(const ColumnPrefetcher&) = delete;
+
+    ColumnPrefetcher& operator=(const ColumnPrefetcher&) = delete;
+
+    // Finishes the column being decoded, queued requests are dropped
+    ~ColumnPrefetcher();
+
+    // Soonest needed first, decoded columns that are not among the positions are dropped
+    void request(const std::vector<nnm::Vector2i>& positions);
+
+    // Whether the position was requested. If so the decoded column is moved out with the heights of its sections to
+    // save, see load_column, or left empty when the save does not have it, waiting for it if it is being decoded. A
+    // request not started yet is cancelled and returns false.
+    bool take(nnm::Vector2i pos, std::optional<ChunkColumn>& column, std::vector<int>& unsaved_heights);
+
+    [[nodiscard]] bool is_ready(nnm::Vector2i pos) const;
+
+    [[nodiscard]] size_t ready_count() const;
+
+private:
+    struct Prefetched {
+        // Empty if the save does not have the column
+        std::optional<ChunkColumn> column;
+        std::vector<int> unsaved_heights;
+    };
+
+    void run();
+
+    SaveFile* m_save;
+    mutable std::mutex m_mutex {};
+    std::condition_variable m_condition {};
+    std::deque<nnm::Vector2i> m_queued {};
+    std::optional<nnm::Vector2i> m_decoding {};
+    std::unordered_map<nnm::Vector2i, Prefetched> m_ready {};
+    bool m_stopping = false;
+    // Started last, once everything it uses is constructed
+    std::thread m_thread;
+};
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "column_store.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "../common/assert.hpp"
+#include "chunk_column.hpp"
+#include "column_codec.hpp"
+#include "lighting.hpp"
+#include "save_file.hpp"
+
+static std::vector<int> section_heights(const ChunkColumn& column)
+{
+    std::vector<int> heights;
+    column.for_each_chunk_data([&](const ChunkData& chunk) { heights.push_back(chunk.position().z); });
+    return heights;
+}
+
+// Returns the heights of the sections relighting added, which shade air under blocks placed after the column was
+// last lit
+static std::vector<int> relight(ChunkColumn& column)
+{
+    const std::vector<int> saved_heights = section_heights(column);
+    relight_loaded_column(column);
+    std::vector<int> added;
+    std::ranges::set_difference(section_heights(column), saved_heights, std::back_inserter(added));
+    return added;
+}
+
+// Columns saved with their light, whole or with their sections apart, are to be saved again without it. Added sections
+// are to be saved before a header listing them is.
+static std::vector<int> unsaved_section_heights(
+    const ChunkColumn& column, const SavedLayout& layout, std::vector<int> added_heights)
+{
+    return layout.lit ? section_heights(column) : std::move(added_heights);
+}
+
+bool load_column(SaveFile& save, const nnm::Vector2i pos, ChunkColumn& column, std::vector<int>& unsaved_heights)
+{
+    const std::optional<std::string_view> data = save.find(encode_column_key(pos));
+    if (!data.has_value()) {
+        return false;
+    }
+    SavedLayout layout;
+    decode_column(*data, column, &layout);
+    for (const int height : layout.heights_apart) {
+        const std::optional<std::string_view> section = save.find(encode_section_key({ pos.x, pos.y, height }));
+        VV_REL_ASSERT(section.has_value(), "[load_column] Missing section of a saved column")
+        decode_section(*section, column, height, layout);
+    }
+    unsaved_heights = unsaved_section_heights(column, layout, relight(column));
+    return true;
+}
+
+void load_columns(
+    SaveFile& save,
+    const nnm::Vector2i min,
+    const nnm::Vector2i max,
+    SectionPool& section_pool,
+    BS::thread_pool& thread_pool,
+    const std::function<bool(nnm::Vector2i pos)>& filter,
+    const std::function<void(ChunkColumn column, std::vector<int> unsaved_heights)>& callable)
+{
+    // Sections arrive right after their column, lowest first like the header lists them
+    struct Loaded {
+        ChunkColumn column;
+        SavedLayout layout;
+        std::vector<int> added_heights;
+    };
+    std::vector<Loaded> loaded;
+    size_t sections_loaded = 0;
+    const auto check_sections = [&] {
+        VV_REL_ASSERT(
+            loaded.empty() || sections_loaded == loaded.back().layout.heights_apart.size(),
+            "[load_columns] Missing section of a saved column")
+    };
+    std::optional<nnm::Vector2i> pos;
+    save.load_region(min, max, [&](const std::string_view key, const std::string_view data) {
+        if (const std::optional<nnm::Vector2i> column_pos = decode_column_key(key); column_pos.has_value()) {
+            check_sections();
+            pos.reset();
+            if (!filter(*column_pos)) {
+                return;
+            }
+            pos = column_pos;
+            // Unpooled, relighting allocates sections on the thread pool and the section pool is not shared
+            loaded.push_back({ ChunkColumn(*pos), {}, {} });
+            sections_loaded = 0;
+            decode_column(data, loaded.back().column, &loaded.back().layout);
+            return;
+        }
+        // Sections of skipped columns are passed over
+        const std::optional<nnm::Vector3i> section_pos = decode_section_key(key);
+        if (!pos.has_value() || !section_pos.has_value() || section_pos->x != pos->x || section_pos->y != pos->y) {
+            return;
+        }
+        if (const std::vector<int>& heights = loaded.back().layout.heights_apart;
+            sections_loaded < heights.size() && heights[sections_loaded] == section_pos->z) {
+            decode_section(data, loaded.back().column, section_pos->z, loaded.back().layout);
+            sections_loaded++;
+        }
+    });
+    check_sections();
+    // Columns only light themselves, so they are relit all at once
+    thread_pool
+        .submit_loop<size_t>(
+            0, loaded.size(), [&](const size_t i) { loaded[i].added_heights = relight(loaded[i].column); })
+        .wait();
+    for (auto& [column, layout, added_heights] : loaded) {
+        std::vector<int> unsaved_heights = unsaved_section_heights(column, layout, std::move(added_heights));
+        column.set_pool(section_pool);
+        callable(std::move(column), std::move(unsaved_heights));
+    }
+}
+
+void save_column(
+    SaveFile& save, const ChunkColumn& column, const std::vector<int>& heights, const std::vector<int>& removed_heights)
+{
+    const nnm::Vector2i pos = column.pos();
+    // The header between, so it never lists sections that are not in the save where writes are not batched
+    for (const int height : heights) {
+        const ChunkData* section = column.find_chunk_data(height);
+        VV_REL_ASSERT(section != nullptr, "[save_column] Column has no section at the height")
+        save.insert(encode_section_key({ pos.x, pos.y, height }), encode_section(*section));
+    }
+    save.insert(encode_column_key(pos), encode_column_header(column));
+    for (const int height : removed_heights) {
+        VV_REL_ASSERT(
+            column.find_chunk_data(height) == nullptr, "[save_column] Removed section is still in the column")
+        save.erase(encode_section_key({ pos.x, pos.y, height }));
+    }
+}
+
+void recompress_column(SaveFile& save, const nnm::Vector2i pos)
+{
+    const std::optional<std::string_view> data = save.find(encode_column_key(pos));
+    if (!data.has_value()) {
+        return;
+    }
+    // Sections are only allocated to learn their heights, not loaded
+    ChunkColumn column(pos);
+    SavedLayout layout;
+    decode_column(*data, column, &layout);
+    save.recompress(encode_column_key(pos));
+    for (const int height : layout.heights_apart) {
+        save.recompress(encode_section_key({ pos.x, pos.y, height }));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <BS_thread_pool.hpp>
+
+#include "common.hpp"
+
+#include <nnm/nnm.hpp>
+
+class ChunkColumn;
+class SaveFile;
+class SectionPool;
+
+// Columns in the save are a header listing their sections, see encode_column_header, and every section under its own
+// key, so saving an edited column only writes the sections that changed. Sunlight is left out, loaded columns are
+// relit with relight_loaded_column. Loading never writes to the save, it gives the heights of the sections the save
+// does not have as loaded for the caller to save: every section of columns saved whole or with all their light by older
+// versions, otherwise the sections relighting added.
+
+// Relit on the calling thread. False if the column was never saved.
+[[nodiscard]] bool load_column(
+    SaveFile& save, nnm::Vector2i pos, ChunkColumn& column, std::vector<int>& unsaved_heights);
+
+// Loads the saved columns from min to max inclusive in one pass over the save, skipping those the filter rejects,
+// which may load them some other way. Columns are relit on the thread pool, then handed the section pool on the calling
+// thread before the callable gets them.
+void load_columns(
+    SaveFile& save,
+    nnm::Vector2i min,
+    nnm::Vector2i max,
+    SectionPool& section_pool,
+    BS::thread_pool& thread_pool,
+    const std::function<bool(nnm::Vector2i pos)>& filter,
+    const std::function<void(ChunkColumn column, std::vector<int> unsaved_heights)>& callable);
+
+// Writes the header and the sections at the given heights, the column's other sections have to be saved already.
+// Sections saved before at the removed heights are deleted, the column must no longer have them.
+void save_column(
+    SaveFile& save,
+    const ChunkColumn& column,
+    const std::vector<int>& heights,
+    const std::vector<int>& removed_heights = {});
+
+// SaveFile::recompress for the header and every section of the column
+void recompress_column(SaveFile& save, nnm::Vector2i pos);
\ No newline at end of file
@@ -285,63 +285,6 @@ inline QuadUVs uvs_from_atlas(const nnm::Vector2i atlas_size, const nnm::Vector2
     return uvs;
 }
 
-inline nnm::Vector2i block_uv(const uint8_t block_type, const Direction face)
-{
-    switch (block_type) {
-    case 1:
-        switch (face) {
-        case Direction::top:
-            return { 1, 0 };
-        case Direction::bottom:
-            return { 0, 1 };
-        default:
-            return { 0, 0 };
-        }
-    case 2:
-        return { 1, 1 };
-    case 3:
-        return { 2, 0 };
-    case 4:
-        return { 0, 1 };
-    case 5:
-        switch (face) {
-        case Direction::top:
-        case Direction::bottom:
-            return { 3, 1 };
-        default:
-            return { 2, 1 };
-        }
-    case 6:
-        return { 0, 2 };
-    case 7:
-        return { 1, 2 };
-    case 8:
-        return { 2, 2 };
-    case 9:
-        return { 3, 2 };
-    case 10:
-        return { 0, 3 };
-    default:
-        return { 0, 0 };
-    }
-}
-
-inline bool is_transparent(const uint8_t block_type)
-{
-    switch (block_type) {
-    case 0:
-    case 9:
-        return true;
-    default:
-        return false;
-    }
-}
-
-inline bool is_emissive(const uint8_t block_type)
-{
-    return block_type == 10;
-}
-
 inline nnm::Vector3i chunk_pos_from_block_pos(const nnm::Vector3i block_pos)
 {
     return { static_cast<int>(nnm::floor(static_cast<float>(block_pos.x) / 16.0f)),
@@ -407,11 +350,6 @@ inline bool is_block_pos_local_col(const nnm::Vector2i block_pos)
     return block_pos.x >= 0 && block_pos.x < 16 && block_pos.y >= 0 && block_pos.y < 16;
 }
 
-inline bool is_block_height_world_valid(const int height)
-{
-    return height >= -160 && height < 160;
-}
-
 template <typename T, typename Pred>
 typename std::vector<T>::iterator insert_sorted(std::vector<T>& vec, T const& item, Pred pred)
 {
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// A vector whose copies share storage until one of them is written. Copying is a reference count bump, so a copy
+// can be handed to another thread as a snapshot while the original keeps being edited. Copies must only be made
+// by the thread that writes or while it is kept from writing, reads and the release of copies may happen anywhere.
+template <typename T>
+class CowVector {
+public:
+    CowVector() = default;
+
+    explicit CowVector(std::vector<T> values)
+        : m_values(values.empty() ? nullptr : std::make_shared<std::vector<T>>(std::move(values)))
+    {
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return m_values == nullptr || m_values->empty();
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_values == nullptr ? 0 : m_values->size();
+    }
+
+    [[nodiscard]] const T& operator[](const size_t i) const
+    {
+        return (*m_values)[i];
+    }
+
+    [[nodiscard]] const T* begin() const
+    {
+        return m_values == nullptr ? nullptr : m_values->data();
+    }
+
+    [[nodiscard]] const T* end() const
+    {
+        return m_values == nullptr ? nullptr : m_values->data() + m_values->size();
+    }
+
+    // Bytes held by the storage, a storage shared with snapshots counts toward each of them
+    [[nodiscard]] size_t memory_usage() const
+    {
+        return m_values == nullptr ? 0 : sizeof(std::vector<T>) + m_values->capacity() * sizeof(T);
+    }
+
+    // Storage only this vector refers to, copied first if a snapshot still shares it
+    [[nodiscard]] std::vector<T>& write()
+    {
+        if (m_values == nullptr) {
+            m_values = std::make_shared<std::vector<T>>();
+        }
+        else if (m_values.use_count() > 1) {
+            m_values = std::make_shared<std::vector<T>>(*m_values);
+        }
+        else {
+            // Pairs with the release of the last snapshot, its reads finish before the storage is written
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return *m_values;
+    }
+
+    // Keeps the capacity unless the storage is shared
+    void clear()
+    {
+        if (m_values != nullptr && m_values.use_count() > 1) {
+            m_values.reset();
+        }
+        else if (m_values != nullptr) {
+            m_values->clear();
+        }
+    }
+
+    void shrink_to_fit()
+    {
+        if (empty()) {
+            m_values.reset();
+        }
+        else if (m_values.use_count() == 1) {
+            m_values->shrink_to_fit();
+        }
+    }
+
+    template <class Archive>
+    void save(Archive& archive) const
+    {
+        static const std::vector<T> empty_values;
+        archive(m_values == nullptr ? empty_values : *m_values);
+    }
+
+    template <class Archive>
+    void load(Archive& archive)
+    {
+        // Serialized as a plain vector
+        archive(write());
+    }
+
+private:
+    std::shared_ptr<std::vector<T>> m_values;
+};
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "distance_buckets.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+void DistanceBuckets::set_center(const nnm::Vector2i center)
+{
+    m_center = center;
+}
+
+void DistanceBuckets::insert(const nnm::Vector2i pos)
+{
+    auto [location, inserted] = m_locations.try_emplace(pos);
+    if (!inserted) {
+        return;
+    }
+    location->index_in_columns = static_cast<int>(m_columns.size());
+    m_columns.push_back(pos);
+    file(pos, *location, bucket_of(pos));
+}
+
+void DistanceBuckets::erase(const nnm::Vector2i pos)
+{
+    const Location* location = m_locations.find(pos);
+    if (location == nullptr) {
+        return;
+    }
+    unfile(*location);
+    // Swap remove, the column moved into the gap takes over the index
+    const nnm::Vector2i moved = m_columns.back();
+    m_columns[location->index_in_columns] = moved;
+    m_locations.at(moved).index_in_columns = location->index_in_columns;
+    m_columns.pop_back();
+    m_locations.erase(pos);
+}
+
+std::optional<nnm::Vector2i> DistanceBuckets::farthest()
+{
+    for (int i = 0; i < sc_refile_per_query && !m_columns.empty(); ++i) {
+        m_refile_cursor = (m_refile_cursor + 1) % m_columns.size();
+        refile(m_columns[m_refile_cursor]);
+    }
+    while (m_top >= 0) {
+        if (m_buckets[m_top].empty()) {
+            m_top--;
+            continue;
+        }
+        const nnm::Vector2i pos = m_buckets[m_top].back();
+        if (bucket_of(pos) == m_top) {
+            return pos;
+        }
+        refile(pos);
+    }
+    return {};
+}
+
+int DistanceBuckets::bucket_of(const nnm::Vector2i pos) const
+{
+    const nnm::Vector2i offset = pos - m_center;
+    const int64_t distance_sqrd = static_cast<int64_t>(offset.x) * offset.x + static_cast<int64_t>(offset.y) * offset.y;
+    return static_cast<int>(std::min<int64_t>(distance_sqrd, sc_max_bucket));
+}
+
+void DistanceBuckets::file(const nnm::Vector2i pos, Location& location, const int bucket)
+{
+    if (bucket >= static_cast<int>(m_buckets.size())) {
+        m_buckets.resize(bucket + 1);
+    }
+    location.bucket = bucket;
+    location.index_in_bucket = static_cast<int>(m_buckets[bucket].size());
+    m_buckets[bucket].push_back(pos);
+    m_top = std::max(m_top, bucket);
+}
+
+void DistanceBuckets::unfile(const Location& location)
+{
+    std::vector<nnm::Vector2i>& bucket = m_buckets[location.bucket];
+    const nnm::Vector2i moved = bucket.back();
+    bucket[location.index_in_bucket] = moved;
+    m_locations.at(moved).index_in_bucket = location.index_in_bucket;
+    bucket.pop_back();
+}
+
+void DistanceBuckets::refile(const nnm::Vector2i pos)
+{
+    Location& location = m_locations.at(pos);
+    if (const int bucket = bucket_of(pos); bucket != location.bucket) {
+        unfile(location);
+        file(pos, location, bucket);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include <nnm/nnm.hpp>
+
+#include "column_grid.hpp"
+
+// Columns filed into buckets by squared distance from a center. Moving the center does not touch the buckets, keys
+// are brought up to date lazily instead: a column found on top under a stale key is re-filed before anything is
+// returned, and every query also re-files a few columns in turn so stale keys deeper down are fixed within a bounded
+// number of queries. Until then the column returned is the farthest among those keyed since the center moved.
+class DistanceBuckets {
+public:
+    void set_center(nnm::Vector2i center);
+
+    void insert(nnm::Vector2i pos);
+
+    void erase(nnm::Vector2i pos);
+
+    [[nodiscard]] std::optional<nnm::Vector2i> farthest();
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_columns.size();
+    }
+
+private:
+    struct Location {
+        int bucket;
+        int index_in_bucket;
+        int index_in_columns;
+    };
+
+    // Columns re-filed per query, with ~3500 resident columns a full pass takes about two seconds of frames
+    static constexpr int sc_refile_per_query = 32;
+    // Columns farther than 128 share the last bucket, any of them is far enough out to cull first
+    static constexpr int sc_max_bucket = 128 * 128;
+
+    [[nodiscard]] int bucket_of(nnm::Vector2i pos) const;
+
+    void file(nnm::Vector2i pos, Location& location, int bucket);
+
+    void unfile(const Location& location);
+
+    void refile(nnm::Vector2i pos);
+
+    nnm::Vector2i m_center {};
+    std::vector<std::vector<nnm::Vector2i>> m_buckets {};
+    int m_top = -1;
+    ColumnGrid<Location> m_locations {};
+    std::vector<nnm::Vector2i> m_columns {};
+    size_t m_refile_cursor = 0;
+};
\ No newline at end of file
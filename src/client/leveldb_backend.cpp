@@ -0,0 +1,190 @@
+#include "leveldb_backend.hpp"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "../common/assert.hpp"
+#include "column_codec.hpp"
+
+LevelDbBackend::LevelDbBackend(const std::string& path, const size_t max_file_size)
+{
+    leveldb::Options db_options;
+    db_options.create_if_missing = true;
+    db_options.compression = leveldb::kNoCompression;
+    db_options.max_file_size = max_file_size;
+    const leveldb::Status db_status = leveldb::DB::Open(db_options, path, &m_db);
+    VV_REL_ASSERT(db_status.ok(), "[LevelDbBackend] Leveldb open not ok for " + path)
+}
+
+LevelDbBackend::~LevelDbBackend()
+{
+    delete m_db;
+}
+
+// ReSharper disable once CppMemberFunctionMayBeConst
+bool LevelDbBackend::read(const std::string_view key, const std::function<void(std::string_view value)>& callable)
+{
+    // Reused by every read on the thread
+    thread_local std::string stored;
+    const leveldb::Status db_status
+        = m_db->Get(leveldb::ReadOptions(), leveldb::Slice(key.data(), key.size()), &stored);
+    if (db_status.IsNotFound()) {
+        return false;
+    }
+    VV_REL_ASSERT(db_status.ok(), "[LevelDbBackend] Failed to get key: " + std::string(key))
+    callable(stored);
+    return true;
+}
+
+void LevelDbBackend::write(const std::string_view key, const std::string_view value)
+{
+    const leveldb::Slice key_slice(key.data(), key.size());
+    const leveldb::Slice value_slice(value.data(), value.size());
+    if (m_batch_thread.load() == std::this_thread::get_id()) {
+        m_batch.Put(key_slice, value_slice);
+    }
+    else {
+        const leveldb::Status db_status = m_db->Put(leveldb::WriteOptions(), key_slice, value_slice);
+        VV_REL_ASSERT(db_status.ok(), "[LevelDbBackend] Failed to write key: " + std::string(key))
+    }
+}
+
+void LevelDbBackend::erase(const std::string_view key)
+{
+    const leveldb::Slice key_slice(key.data(), key.size());
+    if (m_batch_thread.load() == std::this_thread::get_id()) {
+        m_batch.Delete(key_slice);
+    }
+    else {
+        const leveldb::Status db_status = m_db->Delete(leveldb::WriteOptions(), key_slice);
+        VV_REL_ASSERT(db_status.ok(), "[LevelDbBackend] Failed to erase key: " + std::string(key))
+    }
+}
+
+void LevelDbBackend::begin_batch()
+{
+    m_batch.Clear();
+    m_batch_thread = std::this_thread::get_id();
+}
+
+void LevelDbBackend::submit_batch()
+{
+    // ReSharper disable once CppDFAUnusedValue
+    leveldb::Status db_status = m_db->Write(leveldb::WriteOptions(), &m_batch);
+    m_batch.Clear();
+    m_batch_thread = std::thread::id();
+}
+
+// Smallest Morton code past the given one that lies in the rectangle spanned by the codes of its corners, after
+// Tropf and Herzog. Walks the bits from the top, narrowing the rectangle to the half the answer has to be in.
+static uint64_t next_morton_code_in_rect(const uint64_t code, uint64_t min_code, uint64_t max_code)
+{
+    uint64_t next = 0;
+    for (int bit = 63; bit >= 0; --bit) {
+        const uint64_t mask = uint64_t { 1 } << bit;
+        // Bits of the same axis at and below this one
+        const uint64_t axis_mask = (uint64_t { 0x5555555555555555 } << (bit & 1)) & (mask | (mask - 1));
+        // The axis set to 1 here and 0 below, or to 0 here and 1 below
+        const auto lowest_above = [&](const uint64_t value) { return (value & ~axis_mask) | mask; };
+        const auto highest_below = [&](const uint64_t value) { return (value & ~axis_mask) | (axis_mask & ~mask); };
+        const bool code_bit = (code & mask) != 0;
+        const bool min_bit = (min_code & mask) != 0;
+        const bool max_bit = (max_code & mask) != 0;
+        if (!code_bit && !min_bit && max_bit) {
+            next = lowest_above(min_code);
+            max_code = highest_below(max_code);
+        }
+        else if (!code_bit && min_bit && max_bit) {
+            return min_code;
+        }
+        else if (code_bit && !min_bit && !max_bit) {
+            return next;
+        }
+        else if (code_bit && !min_bit && max_bit) {
+            min_code = lowest_above(min_code);
+        }
+    }
+    return next;
+}
+
+void LevelDbBackend::read_region(
+    const nnm::Vector2i min,
+    const nnm::Vector2i max,
+    const std::function<void(std::string_view key, std::string_view value)>& callable)
+{
+    // The iterator reads the database as it was when it was created, writes made by the callable are not seen
+    const uint64_t min_code = column_morton_code(min);
+    const uint64_t max_code = column_morton_code(max);
+    const std::unique_ptr<leveldb::Iterator> it(m_db->NewIterator(leveldb::ReadOptions()));
+    std::string_view seek_key = encode_column_key(min);
+    it->Seek(leveldb::Slice(seek_key.data(), seek_key.size()));
+    while (it->Valid()) {
+        const std::string_view key(it->key().data(), it->key().size());
+        std::optional<nnm::Vector2i> pos = decode_column_key(key);
+        if (const std::optional<nnm::Vector3i> section = decode_section_key(key); section.has_value()) {
+            // Sections share their column's Morton code and sort right after it
+            pos = nnm::Vector2i { section->x, section->y };
+        }
+        if (!pos.has_value()) {
+            return;
+        }
+        const uint64_t code = column_morton_code(*pos);
+        if (code > max_code) {
+            return;
+        }
+        if (pos->x >= min.x && pos->y >= min.y && pos->x <= max.x && pos->y <= max.y) {
+            callable(key, std::string_view(it->value().data(), it->value().size()));
+            it->Next();
+        }
+        else {
+            const uint64_t next_code = next_morton_code_in_rect(code, min_code, max_code);
+            seek_key = encode_column_key(column_pos_from_morton_code(next_code));
+            it->Seek(leveldb::Slice(seek_key.data(), seek_key.size()));
+        }
+    }
+}
+
+// Written once every column is under its current key, saves that have it are not scanned again. Sorts after the
+// column keys, so region reads stop before it.
+static constexpr std::string_view sc_migrated_key = "migrated_column_keys";
+// Columns moved per write, so old saves are not held in memory all at once
+static constexpr size_t sc_migration_batch_size = 256;
+
+size_t LevelDbBackend::migrate_legacy_column_keys()
+{
+    const leveldb::Slice migrated_key(sc_migrated_key.data(), sc_migrated_key.size());
+    if (std::string value; m_db->Get(leveldb::ReadOptions(), migrated_key, &value).ok()) {
+        return 0;
+    }
+    leveldb::WriteBatch batch;
+    const auto write_batch = [&] {
+        const leveldb::Status db_status = m_db->Write(leveldb::WriteOptions(), &batch);
+        VV_REL_ASSERT(db_status.ok(), "[LevelDbBackend] Failed to migrate column keys")
+        batch.Clear();
+    };
+    size_t count = 0;
+    {
+        // Reads the database as it was before the first batch, each batch moves whole columns so a migration that
+        // is cut short carries on from there on the next start
+        const std::unique_ptr<leveldb::Iterator> it(m_db->NewIterator(leveldb::ReadOptions()));
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            const std::optional<nnm::Vector2i> pos
+                = decode_legacy_column_key(std::string_view(it->key().data(), it->key().size()));
+            if (!pos.has_value()) {
+                continue;
+            }
+            // Values are stored the same way under both keys
+            const std::string_view key = encode_column_key(*pos);
+            batch.Put(leveldb::Slice(key.data(), key.size()), it->value());
+            batch.Delete(it->key());
+            if (++count % sc_migration_batch_size == 0) {
+                write_batch();
+            }
+        }
+    }
+    batch.Put(migrated_key, leveldb::Slice());
+    write_batch();
+    return count;
+}
\ No newline at end of file
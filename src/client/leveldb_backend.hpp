@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <leveldb/db.h>
+#include <leveldb/write_batch.h>
+
+#include "save_backend.hpp"
+
+// Any keys, sorted. Region reads walk one iterator over the Morton ordered column keys.
+class LevelDbBackend final : public SaveBackend {
+public:
+    LevelDbBackend(const std::string& path, size_t max_file_size);
+
+    LevelDbBackend(const LevelDbBackend&) = delete;
+
+    LevelDbBackend& operator=(const LevelDbBackend&) = delete;
+
+    ~LevelDbBackend() override;
+
+    bool read(std::string_view key, const std::function<void(std::string_view value)>& callable) override;
+
+    void write(std::string_view key, std::string_view value) override;
+
+    void erase(std::string_view key) override;
+
+    void begin_batch() override;
+
+    void submit_batch() override;
+
+    void read_region(
+        nnm::Vector2i min,
+        nnm::Vector2i max,
+        const std::function<void(std::string_view key, std::string_view value)>& callable) override;
+
+    size_t migrate_legacy_column_keys() override;
+
+private:
+    // Only writes from the thread that began the batch go into it
+    std::atomic<std::thread::id> m_batch_thread {};
+    leveldb::WriteBatch m_batch {};
+    leveldb::DB* m_db {};
+};
\ No newline at end of file
@@ -1,136 +1,212 @@
 #include "lighting.hpp"
 
+#include <bit>
+#include <utility>
+#include <vector>
+
 #include "chunk_column.hpp"
 #include "world_data.hpp"
 
 void apply_sunlight(ChunkColumn& chunk)
 {
-    for_2d({ 0, 0 }, { 16, 16 }, [&](const nnm::Vector2i offset) {
-        const nnm::Vector2i world_col = block_local_to_world_col(chunk.pos(), offset);
-        bool covered = false;
-        for (int i = 9 * 16; i >= -10 * 16; --i) {
-            const nnm::Vector3i world_pos { world_col.x, world_col.y, i };
-            if (!covered) {
-                if (!is_transparent(chunk.get_block(world_pos))) {
-                    covered = true;
-                }
-                else {
-                    chunk.set_lighting(world_pos, 15);
+    if (chunk.min_height() >= chunk.max_height()) {
+        return;
+    }
+    // Height of the highest opaque block in each block column, everything above it is in full sunlight. Searched from
+    // the top a row at a time, block columns drop out once they hit something opaque.
+    std::array<int, 16 * 16> cover_heights {};
+    cover_heights.fill(chunk.min_height() * 16 - 1);
+    std::array<uint16_t, 16> uncovered {};
+    uncovered.fill(0xFFFF);
+    int remaining = 16 * 16;
+    for (int h = chunk.max_height() - 1; h >= chunk.min_height() && remaining > 0; --h) {
+        const ChunkData* data = chunk.find_chunk_data(h);
+        if (data == nullptr) {
+            continue;
+        }
+        for (int z = 15; z >= 0 && remaining > 0; --z) {
+            for (int y = 0; y < 16; ++y) {
+                const uint16_t transparent = data->transparent_row(y, z);
+                for (uint32_t bits = uncovered[y] & ~transparent & 0xFFFF; bits != 0; bits &= bits - 1) {
+                    cover_heights[std::countr_zero(bits) + y * 16] = h * 16 + z;
+                    remaining--;
                 }
+                uncovered[y] &= transparent;
             }
-            else {
-                chunk.set_lighting(world_pos, 0);
+        }
+    }
+    const auto [min_cover, max_cover] = std::ranges::minmax(cover_heights);
+    for (int h = chunk.min_height(); h < chunk.max_height(); ++h) {
+        const int bottom = h * 16;
+        if (max_cover < bottom) {
+            if (ChunkData* data = chunk.find_chunk_data(h); data != nullptr) {
+                data->reset_light(LightChannel::sky, 15);
+            }
+            continue;
+        }
+        // Shadowed air has to be stored, a missing section would read as open sky
+        ChunkData& data = chunk.chunk_data_at(h);
+        data.reset_light(LightChannel::sky, 0);
+        if (min_cover >= bottom + 15) {
+            continue;
+        }
+        for_3d({ 0, 0, 0 }, { 16, 16, 16 }, [&](const nnm::Vector3i pos) {
+            if (bottom + pos.z > cover_heights[pos.x + pos.y * 16]) {
+                data.set_light(pos, LightChannel::sky, 15);
             }
+        });
+    }
+}
+
+void relight_loaded_column(ChunkColumn& column)
+{
+    std::vector<std::pair<ChunkData*, ChunkData>> spread;
+    column.for_each_chunk_data([&](ChunkData& chunk) {
+        if (chunk.has_spread_light()) {
+            spread.emplace_back(&chunk, chunk.snapshot());
         }
     });
+    apply_sunlight(column);
+    for (auto& [chunk, saved] : spread) {
+        if (chunk->has_same_lighting(saved)) {
+            chunk->set_spread_light(false);
+        }
+        else {
+            chunk->copy_lighting(saved);
+        }
+    }
 }
 
 void propagate_light(WorldData& world_data, const nnm::Vector3i chunk_pos)
 {
+    // Positions are relative to the section origin and stay within its 26 neighbours, -16 to 31 on each axis
     static std::vector<std::pair<nnm::Vector3i, uint8_t>> queue;
     queue.clear();
 
     const std::array<nnm::Vector3i, 6> adjacent
         = { { { 0, 0, 1 }, { 0, 0, -1 }, { 0, 1, 0 }, { 0, -1, 0 }, { 1, 0, 0 }, { -1, 0, 0 } } };
 
-    std::array<nnm::Vector3i, 26> surr_pos {};
-    {
-        int i = 0;
-        for_3d({ -1, -1, -1 }, { 2, 2, 2 }, [&](const nnm::Vector3i pos) {
-            if (pos != nnm::Vector3i::zero()) {
-                surr_pos[i] = pos;
-                ++i;
-            }
-        });
-    }
+    // Section offsets come straight from an arithmetic shift, the section itself sits in the middle at 13
+    auto section_index = [](const nnm::Vector3i pos) -> int {
+        VV_DEB_ASSERT(
+            pos.x >= -16 && pos.x < 32 && pos.y >= -16 && pos.y < 32 && pos.z >= -16 && pos.z < 32,
+            "[Lighting] Position outside of neighboring sections");
+        return (pos.x >> 4) + 1 + ((pos.y >> 4) + 1) * 3 + ((pos.z >> 4) + 1) * 9;
+    };
+
+    auto local_pos = [](const nnm::Vector3i pos) -> nnm::Vector3i { return { pos.x & 15, pos.y & 15, pos.z & 15 }; };
 
-    ChunkData& current_chunk_data = world_data.chunk_data_at(chunk_pos);
-    std::array<std::optional<ChunkData*>, 26> surr_chunks {};
-    for (int i = 0; i < surr_pos.size(); ++i) {
-        if (world_data.contains_chunk(chunk_pos + surr_pos[i])) {
-            surr_chunks[i] = &world_data.chunk_data_at(chunk_pos + surr_pos[i]);
+    // Missing sections of loaded columns are open sky, unloaded columns are outside the world
+    std::array<ChunkData*, 27> chunks {};
+    std::array<bool, 27> loaded {};
+    for_3d({ -1, -1, -1 }, { 2, 2, 2 }, [&](const nnm::Vector3i offset) {
+        const int i = section_index(offset * 16);
+        loaded[i] = world_data.contains_column({ chunk_pos.x + offset.x, chunk_pos.y + offset.y });
+        if (world_data.contains_chunk(chunk_pos + offset)) {
+            chunks[i] = &world_data.chunk_data_at(chunk_pos + offset);
         }
-    }
+    });
+    ChunkData& current_chunk_data = *chunks[13];
 
-    auto fast_lighting_at = [&](const nnm::Vector3i pos) -> std::optional<uint8_t> {
-        const nnm::Vector3i offset = chunk_pos_from_block_pos(pos) - chunk_pos;
-        const nnm::Vector3i local_pos = block_world_to_local(pos);
-        if (offset == nnm::Vector3i(0, 0, 0)) {
-            return current_chunk_data.lighting_at(local_pos);
-        }
-        for (int i = 0; i < surr_chunks.size(); ++i) {
-            if (offset == surr_pos[i]) {
-                return surr_chunks[i].has_value()
-                    ? surr_chunks[i].value()->lighting_at(local_pos)
-                    : std::optional<uint8_t> {};
-            }
+    auto fast_lighting_at = [&](const nnm::Vector3i pos, const LightChannel channel) -> std::optional<uint8_t> {
+        const int i = section_index(pos);
+        if (!loaded[i]) {
+            return {};
         }
-        VV_DEB_ASSERT(false, "Unreachable");
-        return {};
+        return chunks[i] != nullptr ? chunks[i]->light_at(local_pos(pos), channel)
+                                    : ChunkColumn::sky_light_value(channel);
     };
 
-    auto fast_block_at = [&](const nnm::Vector3i pos) -> std::optional<uint8_t> {
-        const nnm::Vector3i offset = chunk_pos_from_block_pos(pos) - chunk_pos;
-        const nnm::Vector3i local_pos = block_world_to_local(pos);
-        if (offset == nnm::Vector3i(0, 0, 0)) {
-            return current_chunk_data.get_block(local_pos);
-        }
-        for (int i = 0; i < surr_chunks.size(); ++i) {
-            if (offset == surr_pos[i]) {
-                return surr_chunks[i].has_value()
-                    ? surr_chunks[i].value()->get_block(local_pos)
-                    : std::optional<uint8_t> {};
-            }
+    auto fast_is_transparent = [&](const nnm::Vector3i pos) -> std::optional<bool> {
+        const int i = section_index(pos);
+        if (!loaded[i]) {
+            return {};
         }
-        VV_DEB_ASSERT(false, "Unreachable");
-        return {};
+        return chunks[i] == nullptr || chunks[i]->is_transparent_at(local_pos(pos));
     };
 
-    auto fast_set_lighting = [&](const nnm::Vector3i pos, const uint8_t val) {
-        const nnm::Vector3i offset = chunk_pos_from_block_pos(pos) - chunk_pos;
-        const nnm::Vector3i local_pos = block_world_to_local(pos);
-        if (offset == nnm::Vector3i(0, 0, 0)) {
-            return current_chunk_data.set_lighting(local_pos, val);
+    auto fast_set_lighting = [&](const nnm::Vector3i pos, const LightChannel channel, const uint8_t val) {
+        const int i = section_index(pos);
+        if (chunks[i] == nullptr) {
+            chunks[i] = &world_data.chunk_data_at(chunk_pos + nnm::Vector3i(pos.x >> 4, pos.y >> 4, pos.z >> 4));
         }
-        for (int i = 0; i < surr_chunks.size(); ++i) {
-            if (offset == surr_pos[i]) {
-                surr_chunks[i].value()->set_lighting(local_pos, val);
-                return;
+        chunks[i]->set_light(local_pos(pos), channel, val);
+        chunks[i]->set_spread_light(true);
+    };
+
+    auto flood_queue = [&](const LightChannel channel) {
+        while (!queue.empty()) {
+            const auto [pos, prev_val] = queue.back();
+            queue.pop_back();
+            for (const nnm::Vector3i offset : adjacent) {
+                const nnm::Vector3i adj_pos = pos + offset;
+                const std::optional<uint8_t> current_lighting = fast_lighting_at(adj_pos, channel);
+                // ReSharper disable once CppTooWideScopeInitStatement
+                const std::optional<bool> transparent = fast_is_transparent(adj_pos);
+                if (transparent.has_value() && current_lighting.has_value() && current_lighting < prev_val - 1
+                    && transparent.value()) {
+                    fast_set_lighting(adj_pos, channel, prev_val - 1);
+                    if (prev_val - 1 > 1) {
+                        queue.emplace_back(adj_pos, prev_val - 1);
+                    }
+                }
             }
         }
-        VV_DEB_ASSERT(false, "Unreachable");
     };
 
+    // Skylight spreads sideways and down from every voxel in full sunlight
     for_3d({ 0, 0, 0 }, { 16, 16, 16 }, [&](const nnm::Vector3i pos) {
-        const nnm::Vector3i world_pos = block_local_to_world(chunk_pos, pos);
-        if (const std::optional<uint8_t> block = fast_block_at(world_pos);
-            fast_lighting_at(world_pos) >= 15 || (block.has_value() && block.value() == 9)) {
-            queue.emplace_back(world_pos, 15);
+        if (current_chunk_data.light_at(pos, LightChannel::sky) >= 15) {
+            queue.emplace_back(pos, 15);
         }
     });
-
-    while (!queue.empty()) {
-        const auto [pos, prev_val] = queue.back();
-        queue.pop_back();
-        for (const nnm::Vector3i offset : adjacent) {
-            const nnm::Vector3i adj_pos = pos + offset;
-            const std::optional<uint8_t> current_lighting = fast_lighting_at(adj_pos);
-            // ReSharper disable once CppTooWideScopeInitStatement
-            const std::optional<uint8_t> block_type = fast_block_at(adj_pos);
-            if (block_type.has_value() && current_lighting.has_value() && current_lighting < prev_val - 1
-                && is_transparent(block_type.value())) {
-                fast_set_lighting(adj_pos, prev_val - 1);
-                if (prev_val - 1 > 1) {
-                    queue.emplace_back(adj_pos, prev_val - 1);
-                }
-            }
+    // Open sky sections never get a pass of their own, so their light is let in across the shared face here
+    for (const nnm::Vector3i offset : adjacent) {
+        // ReSharper disable once CppTooWideScopeInitStatement
+        const int i = section_index(offset * 16);
+        if (!loaded[i] || chunks[i] != nullptr) {
+            continue;
         }
+        for_3d({ 0, 0, 0 }, { 16, 16, 16 }, [&](const nnm::Vector3i pos) {
+            if (!is_block_pos_local(pos + offset)) {
+                queue.emplace_back(pos + offset, 15);
+            }
+        });
     }
+    flood_queue(LightChannel::sky);
+
+    // Blocklight spreads from emissive blocks independently of the sky
+    for_3d({ 0, 0, 0 }, { 16, 16, 16 }, [&](const nnm::Vector3i pos) {
+        if (const uint8_t emission = block_emission(current_chunk_data.get_block(pos)); emission != 0) {
+            current_chunk_data.set_light(pos, LightChannel::block, emission);
+            current_chunk_data.set_spread_light(true);
+            queue.emplace_back(pos, emission);
+        }
+    });
+    flood_queue(LightChannel::block);
 }
 
-void refresh_lighting(WorldData& world_data, const nnm::Vector3i chunk_pos)
+// Recomputes the light around the section, holding the columns it writes locked
+static void relight(WorldData& world_data, const nnm::Vector3i chunk_pos)
 {
-    // TODO: Make lighting queue and need to do whole column
+    // Sunlight rewrites the whole of the 3x3 columns and propagation reaches two sections out. Light is recomputed
+    // from scratch, only what ends up different counts as a change.
+    const WorldData::ColumnLock lock = world_data.lock_columns(
+        { chunk_pos.x - 2, chunk_pos.y - 2 }, { chunk_pos.x + 2, chunk_pos.y + 2 }, WorldData::LockMode::write);
+    std::vector<ChunkData*> rebuilt;
+    for_2d({ -2, -2 }, { 3, 3 }, [&](const nnm::Vector2i offset) {
+        const nnm::Vector2i col_pos { chunk_pos.x + offset.x, chunk_pos.y + offset.y };
+        if (!world_data.contains_column(col_pos)) {
+            return;
+        }
+        const bool sunlit = std::abs(offset.x) <= 1 && std::abs(offset.y) <= 1;
+        world_data.chunk_column_data_at(col_pos).for_each_chunk_data([&](ChunkData& chunk) {
+            if (sunlit || std::abs(chunk.position().z - chunk_pos.z) <= 2) {
+                chunk.begin_light_rebuild();
+                rebuilt.push_back(&chunk);
+            }
+        });
+    });
 
     for_3d({ -1, -1, -1 }, { 2, 2, 2 }, [&](const nnm::Vector3i offset) {
         if (world_data.contains_chunk(chunk_pos + offset)) {
@@ -149,4 +225,33 @@ void refresh_lighting(WorldData& world_data, const nnm::Vector3i chunk_pos)
             propagate_light(world_data, chunk_pos + offset);
         }
     });
+
+    for (ChunkData* chunk : rebuilt) {
+        chunk->end_light_rebuild();
+    }
+    for_3d({ -1, -1, -1 }, { 2, 2, 2 }, [&](const nnm::Vector3i offset) {
+        if (world_data.contains_chunk(chunk_pos + offset)) {
+            world_data.chunk_data_at(chunk_pos + offset).mark_lit();
+        }
+    });
+}
+
+void refresh_lighting(WorldData& world_data, const nnm::Vector3i chunk_pos)
+{
+    // TODO: Make lighting queue and need to do whole column
+
+    bool lit = true;
+    for_3d({ -1, -1, -1 }, { 2, 2, 2 }, [&](const nnm::Vector3i offset) {
+        if (world_data.contains_chunk(chunk_pos + offset) && !world_data.chunk_data_at(chunk_pos + offset).is_lit()) {
+            lit = false;
+        }
+    });
+    if (lit) {
+        return;
+    }
+    relight(world_data, chunk_pos);
+    // Rebuilt light can spread out uniform sections into per voxel arrays, which the memory budget has to see
+    for_2d({ -2, -2 }, { 3, 3 }, [&](const nnm::Vector2i offset) {
+        world_data.update_memory_usage({ chunk_pos.x + offset.x, chunk_pos.y + offset.y });
+    });
 }
\ No newline at end of file
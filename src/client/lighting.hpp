@@ -9,6 +9,10 @@ class ChunkColumn;
 
 void apply_sunlight(ChunkColumn& chunk);
 
+// Columns are saved without sunlight. Rebuilds it from the column's own blocks, so columns can be relit on any thread
+// that owns them. Saved spread light is kept unless it turns out to be sunlight alone.
+void relight_loaded_column(ChunkColumn& column);
+
 void propagate_light(WorldData& world_data, nnm::Vector3i chunk_pos);
 
 void refresh_lighting(WorldData& world_data, nnm::Vector3i chunk_pos);
@@ -4,6 +4,7 @@
 
 #include "../common/logger.hpp"
 #include "app.hpp"
+#include "block_registry.hpp"
 
 int main()
 {
@@ -22,6 +23,8 @@ int main()
         VV_REL_ASSERT(result, "[Main] Failed to create save dir")
     }
 
+    load_block_registry(res_path("blocks.json"));
+
     //    try {
     app::App instance;
     instance.main_loop();
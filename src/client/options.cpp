@@ -51,6 +51,14 @@ Options load_options()
             break;
         }
     }
+    if (data.contains("memory_budget_mb") && data["memory_budget_mb"].is_number_integer()
+        && data["memory_budget_mb"].get<int>() >= 0) {
+        options.memory_budget_mb = data["memory_budget_mb"].get<int>();
+    }
+    if (data.contains("cache_budget_mb") && data["cache_budget_mb"].is_number_integer()
+        && data["cache_budget_mb"].get<int>() >= 0) {
+        options.cache_budget_mb = data["cache_budget_mb"].get<int>();
+    }
     return options;
 }
 
@@ -77,6 +85,9 @@ void set_options(const Options& options)
     };
 
     std::ofstream file("options.json");
-    const json data = { { "fullscreen", options.fullscreen }, { "msaa", msaa_int(options.msaa) } };
+    const json data = { { "fullscreen", options.fullscreen },
+                        { "msaa", msaa_int(options.msaa) },
+                        { "memory_budget_mb", options.memory_budget_mb },
+                        { "cache_budget_mb", options.cache_budget_mb } };
     file << std::setw(4) << data << std::endl;
 }
\ No newline at end of file
@@ -5,6 +5,10 @@
 struct Options {
     bool fullscreen = false;
     mve::Msaa msaa = mve::Msaa::samples_1;
+    // Columns out of view stay loaded until resident columns would take more than this
+    int memory_budget_mb = 512;
+    // Evicted columns are kept compressed in memory up to this, instead of being read back from the save
+    int cache_budget_mb = 64;
 };
 
 Options load_options();
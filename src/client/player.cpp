@@ -3,6 +3,7 @@
 #include "common.hpp"
 #include <cereal/archives/portable_binary.hpp>
 
+#include "block_accessor.hpp"
 #include "world_data.hpp"
 #include <nnm/nnm.hpp>
 
@@ -135,17 +136,22 @@ void Player::fixed_update(const mve::Window& window, const WorldData& data, cons
 nnm::Vector3f Player::move_and_slide(
     BoundingBox box, nnm::Vector3f& pos, const nnm::Vector3f velocity, const WorldData& data)
 {
-    auto detect_collision = [](const nnm::Vector3f vel, const BoundingBox& bbox, const WorldData& world_data) {
+    std::vector<uint8_t> blocks;
+    auto detect_collision = [&](const nnm::Vector3f vel, const BoundingBox& bbox, const WorldData& world_data) {
         const BoundingBox broadphase_box = swept_broadphase_box(vel, bbox);
         SweptBoundingBoxCollision min_collision { .time = 1.0f, .normal = nnm::Vector3f::zero() };
         const auto min_neighbor = nnm::Vector3i(broadphase_box.min.round());
         const nnm::Vector3i max_neighbor = nnm::Vector3i(broadphase_box.max.round()) + nnm::Vector3i(1, 1, 2);
-        for_3d(min_neighbor, max_neighbor, [&](const nnm::Vector3i neighbor) {
-            const nnm::Vector3i block_pos = neighbor - nnm::Vector3i(0, 0, 1);
-            const std::optional<uint8_t> block = world_data.block_at(block_pos);
+        const BlockRange range { min_neighbor - nnm::Vector3i(0, 0, 1), max_neighbor - nnm::Vector3i(0, 0, 1) };
+        blocks.resize(BlockAccessor::volume(range));
+        BlockAccessor(world_data).read_blocks(range, blocks);
+        const nnm::Vector3i size = range.max - range.min;
+        for_3d(range.min, range.max, [&](const nnm::Vector3i block_pos) {
+            const nnm::Vector3i offset = block_pos - range.min;
+            const uint8_t block = blocks[(offset.z * size.y + offset.y) * size.x + offset.x];
             if (const BoundingBox block_bb { { nnm::Vector3f(block_pos) - nnm::Vector3f::all(0.5f) },
                                              { nnm::Vector3f(block_pos) + nnm::Vector3f::all(0.5f) } };
-                block.has_value() && block.value() != 0 && collides(block_bb, broadphase_box)) {
+                block != 0 && collides(block_bb, broadphase_box)) {
                 if (const SweptBoundingBoxCollision collision = swept_bounding_box(vel, bbox, block_bb);
                     collision.time < min_collision.time) {
                     min_collision = collision;
@@ -195,12 +201,14 @@ bool Player::is_on_ground(const WorldData& data) const
     bb.max += nnm::Vector3(-0.001f, -0.001f, -0.001f);
     const nnm::Vector3i block_pos = block_position();
     bool is_on_ground = false;
+    BlockAccessor accessor(data);
     for_2d({ -1, -1 }, { 2, 2 }, [&](const nnm::Vector2i neighbor) {
         const BoundingBox block_bb {
             { nnm::Vector3f(block_pos + nnm::Vector3i(neighbor.x, neighbor.y, -1)) - nnm::Vector3f::all(0.5f) },
             { nnm::Vector3f(block_pos + nnm::Vector3i(neighbor.x, neighbor.y, -1)) + nnm::Vector3f::all(0.5f) }
         };
-        if (const std::optional<uint8_t> block = data.block_at(block_pos + nnm::Vector3i(neighbor.x, neighbor.y, -1));
+        if (const std::optional<uint8_t> block
+            = accessor.block_at(block_pos + nnm::Vector3i(neighbor.x, neighbor.y, -1));
             block.has_value() && block.value() != 0 && collides(bb, block_bb)) {
             is_on_ground = true;
         }
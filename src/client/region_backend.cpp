@@ -0,0 +1,542 @@
+#include "region_backend.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../common/assert.hpp"
+#include "../common/logger.hpp"
+#include "column_codec.hpp"
+
+// A file mapped read and write in full, remapped when it is resized
+class MappedFile {
+public:
+    // Creates the file empty if it does not exist, see is_open
+    explicit MappedFile(const std::filesystem::path& path)
+    {
+#ifdef _WIN32
+        m_file = CreateFileW(
+            path.c_str(),
+            GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ,
+            nullptr,
+            OPEN_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        LARGE_INTEGER size;
+        VV_REL_ASSERT(GetFileSizeEx(m_file, &size), "[MappedFile] Failed to get size of " + path.string())
+        m_size = static_cast<size_t>(size.QuadPart);
+#else
+        m_fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (m_fd < 0) {
+            return;
+        }
+        struct stat file_stat {};
+        VV_REL_ASSERT(fstat(m_fd, &file_stat) == 0, "[MappedFile] Failed to get size of " + path.string())
+        m_size = static_cast<size_t>(file_stat.st_size);
+#endif
+        map();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        if (!is_open()) {
+            return;
+        }
+        unmap();
+#ifdef _WIN32
+        CloseHandle(m_file);
+#else
+        close(m_fd);
+#endif
+    }
+
+    // False if opening failed, such as when the process ran out of file descriptors
+    [[nodiscard]] bool is_open() const
+    {
+#ifdef _WIN32
+        return m_file != INVALID_HANDLE_VALUE;
+#else
+        return m_fd >= 0;
+#endif
+    }
+
+    [[nodiscard]] char* data() const
+    {
+        return m_data;
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_size;
+    }
+
+    // Bytes added at the end read as zero, pointers into the old mapping are invalidated
+    void resize(const size_t size)
+    {
+        unmap();
+#ifdef _WIN32
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(size);
+        VV_REL_ASSERT(
+            SetFilePointerEx(m_file, end, nullptr, FILE_BEGIN) && SetEndOfFile(m_file),
+            "[MappedFile] Failed to resize file")
+#else
+        VV_REL_ASSERT(ftruncate(m_fd, static_cast<off_t>(size)) == 0, "[MappedFile] Failed to resize file")
+#endif
+        m_size = size;
+        map();
+    }
+
+    // Blocks until the mapped contents are on disk
+    void flush() const
+    {
+        if (m_data == nullptr) {
+            return;
+        }
+#ifdef _WIN32
+        FlushViewOfFile(m_data, m_size);
+        FlushFileBuffers(m_file);
+#else
+        msync(m_data, m_size, MS_SYNC);
+#endif
+    }
+
+private:
+    void map()
+    {
+        // Empty files cannot be mapped
+        if (m_size == 0) {
+            return;
+        }
+#ifdef _WIN32
+        m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+        VV_REL_ASSERT(m_mapping != nullptr, "[MappedFile] Failed to create mapping")
+        m_data = static_cast<char*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, m_size));
+        VV_REL_ASSERT(m_data != nullptr, "[MappedFile] Failed to map file")
+#else
+        void* data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        VV_REL_ASSERT(data != MAP_FAILED, "[MappedFile] Failed to map file")
+        m_data = static_cast<char*>(data);
+#endif
+    }
+
+    void unmap()
+    {
+        if (m_data != nullptr) {
+#ifdef _WIN32
+            UnmapViewOfFile(m_data);
+#else
+            munmap(m_data, m_size);
+#endif
+            m_data = nullptr;
+        }
+#ifdef _WIN32
+        if (m_mapping != nullptr) {
+            CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+#endif
+    }
+
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#else
+    int m_fd = -1;
+#endif
+    char* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+// The table is an entry per column in row order, giving the first sector and the byte size of its value with zero
+// meaning no value. Entries are little endian like the rest of the save. The sector size is up to the file's user.
+class RegionFile {
+public:
+    RegionFile(const std::filesystem::path& path, const size_t sector_size)
+        : m_file(path)
+        , m_sector_size(sector_size)
+        , m_table_sectors(sc_table_size / sector_size)
+    {
+        VV_DEB_ASSERT(sc_table_size % sector_size == 0, "[RegionFile] Table does not fill whole sectors")
+        if (!m_file.is_open()) {
+            return;
+        }
+        if (m_file.size() == 0) {
+            m_file.resize(sc_table_size);
+        }
+        VV_REL_ASSERT(
+            m_file.size() % m_sector_size == 0 && m_file.size() >= sc_table_size,
+            "[RegionFile] Invalid size of " + path.string())
+        m_used_sectors.resize(m_file.size() / m_sector_size);
+        std::fill_n(m_used_sectors.begin(), m_table_sectors, true);
+        for (int i = 0; i < sc_columns; ++i) {
+            const Entry entry = entry_at(i);
+            if (entry.size == 0) {
+                continue;
+            }
+            VV_REL_ASSERT(
+                entry.sector >= m_table_sectors && entry.sector + sector_count(entry.size) <= m_used_sectors.size(),
+                "[RegionFile] Column outside of " + path.string())
+            for (size_t s = entry.sector; s < entry.sector + sector_count(entry.size); ++s) {
+                VV_REL_ASSERT(!m_used_sectors[s], "[RegionFile] Overlapping columns in " + path.string())
+                m_used_sectors[s] = true;
+            }
+        }
+    }
+
+    // Empty if the column has no value, valid until the next write
+    [[nodiscard]] std::string_view read(const int index) const
+    {
+        const Entry entry = entry_at(index);
+        return { m_file.data() + entry.sector * m_sector_size, entry.size };
+    }
+
+    void write(const int index, const std::string_view value)
+    {
+        VV_REL_ASSERT(!value.empty() && value.size() <= UINT32_MAX, "[RegionFile] Invalid value size")
+        const Entry prev = entry_at(index);
+        // The old sectors stay untouched until the table points at the new ones
+        const size_t sector = allocate(sector_count(value.size()));
+        std::memcpy(m_file.data() + sector * m_sector_size, value.data(), value.size());
+        set_entry(index, { static_cast<uint32_t>(sector), static_cast<uint32_t>(value.size()) });
+        if (prev.size != 0) {
+            std::fill_n(m_used_sectors.begin() + prev.sector, sector_count(prev.size), false);
+        }
+    }
+
+    void erase(const int index)
+    {
+        const Entry prev = entry_at(index);
+        if (prev.size == 0) {
+            return;
+        }
+        set_entry(index, {});
+        std::fill_n(m_used_sectors.begin() + prev.sector, sector_count(prev.size), false);
+    }
+
+    void flush() const
+    {
+        m_file.flush();
+    }
+
+    [[nodiscard]] bool is_open() const
+    {
+        return m_file.is_open();
+    }
+
+    static constexpr int sc_columns = RegionBackend::sc_region_size * RegionBackend::sc_region_size;
+
+private:
+    struct Entry {
+        uint32_t sector;
+        uint32_t size;
+    };
+
+    static constexpr size_t sc_table_size = sc_columns * sizeof(Entry);
+
+    [[nodiscard]] size_t sector_count(const size_t bytes) const
+    {
+        return (bytes + m_sector_size - 1) / m_sector_size;
+    }
+
+    [[nodiscard]] Entry entry_at(const int index) const
+    {
+        Entry entry {};
+        std::memcpy(&entry, m_file.data() + index * sizeof(Entry), sizeof(Entry));
+        return entry;
+    }
+
+    void set_entry(const int index, const Entry entry)
+    {
+        std::memcpy(m_file.data() + index * sizeof(Entry), &entry, sizeof(Entry));
+    }
+
+    // First run of free sectors that fits, otherwise the file grows by at least half so appends rarely remap
+    size_t allocate(const size_t count)
+    {
+        size_t run = 0;
+        for (size_t s = m_table_sectors; s < m_used_sectors.size(); ++s) {
+            run = m_used_sectors[s] ? 0 : run + 1;
+            if (run == count) {
+                const size_t start = s + 1 - count;
+                std::fill_n(m_used_sectors.begin() + start, count, true);
+                return start;
+            }
+        }
+        // The free sectors at the end are the start of the run
+        const size_t start = m_used_sectors.size() - run;
+        const size_t sectors = std::max(start + count, m_used_sectors.size() + m_used_sectors.size() / 2);
+        m_file.resize(sectors * m_sector_size);
+        m_used_sectors.resize(sectors);
+        std::fill_n(m_used_sectors.begin() + start, count, true);
+        return start;
+    }
+
+    MappedFile m_file;
+    size_t m_sector_size;
+    size_t m_table_sectors;
+    std::vector<bool> m_used_sectors {};
+};
+
+static nnm::Vector2i region_pos(const nnm::Vector2i pos)
+{
+    // Arithmetic shifts floor negative positions too
+    return { pos.x >> 5, pos.y >> 5 };
+}
+
+static int column_index(const nnm::Vector2i pos)
+{
+    return (pos.y & (RegionBackend::sc_region_size - 1)) * RegionBackend::sc_region_size
+        + (pos.x & (RegionBackend::sc_region_size - 1));
+}
+
+std::pair<nnm::Vector3i, int> RegionBackend::key_location(const std::string_view key)
+{
+    nnm::Vector3i chunk_pos;
+    int layer;
+    if (const std::optional<nnm::Vector2i> pos = decode_column_key(key); pos.has_value()) {
+        chunk_pos = { pos->x, pos->y, 0 };
+        layer = sc_column_layer;
+    }
+    else {
+        const std::optional<nnm::Vector3i> section_pos = decode_section_key(key);
+        VV_REL_ASSERT(section_pos.has_value(), "[RegionBackend] Only columns and sections can be stored")
+        chunk_pos = *section_pos;
+        layer = section_pos->z;
+    }
+    const nnm::Vector2i region = region_pos({ chunk_pos.x, chunk_pos.y });
+    return { { region.x, region.y, layer }, column_index({ chunk_pos.x, chunk_pos.y }) };
+}
+
+RegionBackend::RegionBackend(std::filesystem::path directory)
+    : m_directory(std::move(directory))
+{
+    static_assert(sc_region_size == 1 << 5, "Regions are addressed by shifting");
+    std::filesystem::create_directories(m_directory);
+    // Region reads go through the sections of every height a region has, column files only say which columns exist
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(m_directory)) {
+        nnm::Vector2i region;
+        int height;
+        if (std::sscanf(entry.path().filename().string().c_str(), "%d.%d.%d.region", &region.x, &region.y, &height)
+            == 3) {
+            m_section_heights[region].insert(height);
+        }
+    }
+}
+
+RegionBackend::~RegionBackend()
+{
+    for (const auto& [file_id, region] : m_regions) {
+        if (region.file != nullptr) {
+            region.file->flush();
+        }
+    }
+}
+
+bool RegionBackend::read(const std::string_view key, const std::function<void(std::string_view value)>& callable)
+{
+    const auto [file_id, index] = key_location(key);
+    std::shared_lock lock(m_mutex);
+    const RegionFile* region = open_region(lock, file_id);
+    if (region == nullptr) {
+        return false;
+    }
+    // Straight out of the mapping, the shared lock keeps writes from remapping it meanwhile
+    const std::string_view value = region->read(index);
+    if (value.empty()) {
+        return false;
+    }
+    callable(value);
+    return true;
+}
+
+void RegionBackend::write(const std::string_view key, const std::string_view value)
+{
+    const auto [file_id, index] = key_location(key);
+    std::unique_lock lock(m_mutex);
+    RegionFile* file = open_region(file_id, true);
+    if (file == nullptr) {
+        LOG->error("[RegionBackend] Value not saved, failed to open " + region_path(file_id).string());
+        return;
+    }
+    file->write(index, value);
+}
+
+void RegionBackend::erase(const std::string_view key)
+{
+    const auto [file_id, index] = key_location(key);
+    std::unique_lock lock(m_mutex);
+    if (RegionFile* file = open_region(file_id, false); file != nullptr) {
+        file->erase(index);
+    }
+}
+
+void RegionBackend::read_region(
+    const nnm::Vector2i min,
+    const nnm::Vector2i max,
+    const std::function<void(std::string_view key, std::string_view value)>& callable)
+{
+    // Values are copied out so the callable runs without the lock and can write
+    thread_local std::string value;
+    // Copied too since the callable may encode keys itself
+    std::string key;
+    const auto read_value = [&](const nnm::Vector3i file_id, const int index) {
+        std::shared_lock lock(m_mutex);
+        const RegionFile* region = open_region(lock, file_id);
+        value = region == nullptr ? std::string_view() : region->read(index);
+        return !value.empty();
+    };
+    const nnm::Vector2i min_region = region_pos(min);
+    const nnm::Vector2i max_region = region_pos(max);
+    std::vector<int> heights;
+    for (int region_y = min_region.y; region_y <= max_region.y; ++region_y) {
+        for (int region_x = min_region.x; region_x <= max_region.x; ++region_x) {
+            {
+                std::shared_lock lock(m_mutex);
+                if (open_region(lock, { region_x, region_y, sc_column_layer }) == nullptr) {
+                    continue;
+                }
+                heights.clear();
+                if (const auto it = m_section_heights.find({ region_x, region_y }); it != m_section_heights.end()) {
+                    heights.assign(it->second.begin(), it->second.end());
+                }
+            }
+            const nnm::Vector2i from { std::max(min.x, region_x * sc_region_size),
+                                       std::max(min.y, region_y * sc_region_size) };
+            const nnm::Vector2i to { std::min(max.x, region_x * sc_region_size + sc_region_size - 1),
+                                     std::min(max.y, region_y * sc_region_size + sc_region_size - 1) };
+            for (int y = from.y; y <= to.y; ++y) {
+                for (int x = from.x; x <= to.x; ++x) {
+                    const int index = column_index({ x, y });
+                    if (!read_value({ region_x, region_y, sc_column_layer }, index)) {
+                        continue;
+                    }
+                    key = encode_column_key({ x, y });
+                    callable(key, value);
+                    for (const int height : heights) {
+                        if (read_value({ region_x, region_y, height }, index)) {
+                            key = encode_section_key({ x, y, height });
+                            callable(key, value);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+std::filesystem::path RegionBackend::region_path(const nnm::Vector3i file_id) const
+{
+    std::string name = std::to_string(file_id.x) + "." + std::to_string(file_id.y);
+    if (file_id.z != sc_column_layer) {
+        name += "." + std::to_string(file_id.z);
+    }
+    return m_directory / (name + ".region");
+}
+
+size_t RegionBackend::sector_size(const nnm::Vector3i file_id)
+{
+    // Column files keep the sectors they had when they held whole columns
+    return file_id.z == sc_column_layer ? 4096 : 512;
+}
+
+RegionFile* RegionBackend::open_region(std::shared_lock<std::shared_mutex>& lock, const nnm::Vector3i file_id)
+{
+    // Other threads can close the file again between the locks, so it is looked up until it is open or known to be
+    // missing
+    while (true) {
+        if (const auto it = m_regions.find(file_id); it != m_regions.end()) {
+            it->second.last_used.store(m_use_count.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+            return it->second.file.get();
+        }
+        lock.unlock();
+        bool looked_up;
+        {
+            std::unique_lock write_lock(m_mutex);
+            open_region(file_id, false);
+            looked_up = m_regions.contains(file_id);
+        }
+        lock.lock();
+        if (!looked_up) {
+            return nullptr;
+        }
+    }
+}
+
+RegionFile* RegionBackend::open_region(const nnm::Vector3i file_id, const bool create)
+{
+    const auto it = m_regions.find(file_id);
+    if (it != m_regions.end() && (it->second.file != nullptr || !create)) {
+        it->second.last_used.store(m_use_count.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+        return it->second.file.get();
+    }
+    const std::filesystem::path path = region_path(file_id);
+    if (!create && !std::filesystem::exists(path)) {
+        m_regions.try_emplace(file_id);
+        return nullptr;
+    }
+    if (m_open_files >= sc_max_open_files) {
+        close_least_recent();
+    }
+    auto file = std::make_unique<RegionFile>(path, sector_size(file_id));
+    if (!file->is_open()) {
+        // Other files of the process can use up the descriptors too, all of these are closed to make room once
+        while (m_open_files > 0) {
+            close_least_recent();
+        }
+        file = std::make_unique<RegionFile>(path, sector_size(file_id));
+        if (!file->is_open()) {
+            LOG->error("[RegionBackend] Failed to open " + path.string());
+            return nullptr;
+        }
+    }
+    if (create && file_id.z != sc_column_layer) {
+        m_section_heights[{ file_id.x, file_id.y }].insert(file_id.z);
+    }
+    Region& region = m_regions[file_id];
+    region.file = std::move(file);
+    region.last_used.store(m_use_count.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    m_open_files++;
+    return region.file.get();
+}
+
+void RegionBackend::close_least_recent()
+{
+    auto least_recent = m_regions.end();
+    for (auto it = m_regions.begin(); it != m_regions.end(); ++it) {
+        if (it->second.file != nullptr
+            && (least_recent == m_regions.end()
+                || it->second.last_used.load(std::memory_order_relaxed)
+                    < least_recent->second.last_used.load(std::memory_order_relaxed))) {
+            least_recent = it;
+        }
+    }
+    if (least_recent != m_regions.end()) {
+        // Unmapping keeps what was written, it is only synced to disk when the backend closes either way
+        m_regions.erase(least_recent);
+        m_open_files--;
+    }
+}
\ No newline at end of file
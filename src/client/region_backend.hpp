@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <set>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "save_backend.hpp"
+
+class RegionFile;
+
+// Columns and their sections only, 32 by 32 columns per memory mapped file with another file per section height.
+// Each file starts with a table giving every column's sectors, so reading a value is a lookup and a view into the
+// mapping. Rewritten values go to newly allocated sectors before the table points at them, then their old sectors are
+// freed. Nothing is synced to disk before the backend closes, writes survive the process crashing but not the system.
+// Only the most recently used files are kept open, with a file per section height a region can have dozens.
+class RegionBackend final : public SaveBackend {
+public:
+    explicit RegionBackend(std::filesystem::path directory);
+
+    RegionBackend(const RegionBackend&) = delete;
+
+    RegionBackend& operator=(const RegionBackend&) = delete;
+
+    ~RegionBackend() override;
+
+    bool read(std::string_view key, const std::function<void(std::string_view value)>& callable) override;
+
+    void write(std::string_view key, std::string_view value) override;
+
+    void erase(std::string_view key) override;
+
+    // Every write is applied on its own
+    void begin_batch() override
+    {
+    }
+
+    void submit_batch() override
+    {
+    }
+
+    void read_region(
+        nnm::Vector2i min,
+        nnm::Vector2i max,
+        const std::function<void(std::string_view key, std::string_view value)>& callable) override;
+
+    // Region saves never used the old keys
+    size_t migrate_legacy_column_keys() override
+    {
+        return 0;
+    }
+
+    static constexpr int sc_region_size = 32;
+
+private:
+    // Section heights are block heights divided by 16, so they never reach the layer of the column files
+    static constexpr int sc_column_layer = std::numeric_limits<int>::min();
+
+    // Files are identified by the region's position and the height of their sections, or sc_column_layer. Returns the
+    // file a key is stored in and its index there.
+    [[nodiscard]] static std::pair<nnm::Vector3i, int> key_location(std::string_view key);
+
+    [[nodiscard]] std::filesystem::path region_path(nnm::Vector3i file_id) const;
+
+    // Sections are around a kilobyte compressed, whole sectors of 4 KiB would mostly go unused
+    [[nodiscard]] static size_t sector_size(nnm::Vector3i file_id);
+
+    static constexpr size_t sc_max_open_files = 256;
+
+    struct Region {
+        // Null if there is no such file
+        std::unique_ptr<RegionFile> file;
+        // Lower for files looked up longer ago, updated under the shared lock
+        std::atomic<uint64_t> last_used = 0;
+    };
+
+    // Null if there is no such file or it failed to open. Takes the mutex exclusively to open the file if it is not
+    // open, the file stays open until the shared lock is released.
+    RegionFile* open_region(std::shared_lock<std::shared_mutex>& lock, nnm::Vector3i file_id);
+
+    // Same with the mutex held exclusively, creating the file if asked to
+    RegionFile* open_region(nnm::Vector3i file_id, bool create);
+
+    // Needs the mutex exclusively
+    void close_least_recent();
+
+    std::filesystem::path m_directory;
+    // Readers hold it shared while they use a view into a file, growing or closing a file needs it exclusively
+    mutable std::shared_mutex m_mutex {};
+    // Files open and files known not to exist until a value is written there
+    std::unordered_map<nnm::Vector3i, Region> m_regions;
+    size_t m_open_files = 0;
+    std::atomic<uint64_t> m_use_count = 0;
+    // Heights of the section files of each region, guarded by the mutex
+    std::unordered_map<nnm::Vector2i, std::set<int>> m_section_heights;
+};
\ No newline at end of file
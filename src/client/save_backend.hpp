@@ -0,0 +1,44 @@
+#pragma once
+
+#include <functional>
+#include <string_view>
+
+#include "common.hpp"
+
+#include <nnm/nnm.hpp>
+
+enum class SaveBackendType { leveldb, region };
+
+// Where SaveFile keeps its values, which arrive already compressed. Reads and writes may come from several threads at
+// once, batches only from one at a time.
+class SaveBackend {
+public:
+    virtual ~SaveBackend() = default;
+
+    // Calls the callable with the stored value if there is one, the view is only valid during the call. Returns
+    // whether there was a value.
+    virtual bool read(std::string_view key, const std::function<void(std::string_view value)>& callable) = 0;
+
+    virtual void write(std::string_view key, std::string_view value) = 0;
+
+    // Does nothing if there is no value
+    virtual void erase(std::string_view key) = 0;
+
+    // Writes from the same thread in between are applied together where the backend supports it, other threads' writes
+    // are applied on their own
+    virtual void begin_batch() = 0;
+
+    virtual void submit_batch() = 0;
+
+    // Every saved column from min to max inclusive keyed as encode_column_key, each followed by its sections saved
+    // apart keyed as encode_section_key, lowest first. The callable may read and write through the backend.
+    virtual void read_region(
+        nnm::Vector2i min,
+        nnm::Vector2i max,
+        const std::function<void(std::string_view key, std::string_view value)>& callable)
+        = 0;
+
+    // Moves columns saved under the keys used before encode_column_key to their current keys, returns how many.
+    // Does nothing once it has run to the end on the save.
+    virtual size_t migrate_legacy_column_keys() = 0;
+};
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "save_dictionary.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+static constexpr size_t sc_string_size = sizeof(uint64_t);
+static constexpr size_t sc_segment_size = 256;
+static constexpr size_t sc_segment_step = 32;
+
+static uint64_t string_at(const std::string_view data, const size_t offset)
+{
+    uint64_t string;
+    std::memcpy(&string, data.data() + offset, sc_string_size);
+    return string;
+}
+
+// Number of samples each string is in, a string found in a single sample is not worth keeping
+static std::unordered_map<uint64_t, int> count_strings(const std::vector<std::string>& samples)
+{
+    std::unordered_map<uint64_t, int> counts;
+    std::unordered_set<uint64_t> seen;
+    for (const std::string& sample : samples) {
+        seen.clear();
+        for (size_t offset = 0; offset + sc_string_size <= sample.size(); ++offset) {
+            if (const uint64_t string = string_at(sample, offset); seen.insert(string).second) {
+                counts[string]++;
+            }
+        }
+    }
+    std::erase_if(counts, [](const std::pair<const uint64_t, int>& entry) {
+        // Runs of one byte compress as well without a dictionary
+        const uint64_t run = (entry.first & 0xff) * 0x0101010101010101;
+        return entry.second < 2 || entry.first == run;
+    });
+    return counts;
+}
+
+std::string train_save_dictionary(const std::vector<std::string>& samples, const size_t max_size)
+{
+    std::unordered_map<uint64_t, int> counts = count_strings(samples);
+
+    std::vector<std::string_view> segments;
+    for (const std::string& sample : samples) {
+        for (size_t offset = 0; offset + sc_string_size <= sample.size(); offset += sc_segment_step) {
+            segments.emplace_back(sample.data() + offset, std::min(sc_segment_size, sample.size() - offset));
+        }
+    }
+
+    std::vector<uint64_t> strings;
+    const auto score = [&](const std::string_view segment) {
+        strings.clear();
+        for (size_t offset = 0; offset + sc_string_size <= segment.size(); ++offset) {
+            strings.push_back(string_at(segment, offset));
+        }
+        std::ranges::sort(strings);
+        const auto [first, last] = std::ranges::unique(strings);
+        strings.erase(first, last);
+        int64_t total = 0;
+        for (const uint64_t string : strings) {
+            if (const auto it = counts.find(string); it != counts.end()) {
+                total += it->second;
+            }
+        }
+        return total;
+    };
+
+    // Scores only drop as strings get covered, so a segment whose updated score still beats the next best one's
+    // possibly stale score is the best
+    std::priority_queue<std::pair<int64_t, size_t>> queue;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (const int64_t segment_score = score(segments[i]); segment_score > 0) {
+            queue.emplace(segment_score, i);
+        }
+    }
+    std::vector<std::string_view> picked;
+    size_t size = 0;
+    while (!queue.empty() && size < max_size) {
+        const size_t index = queue.top().second;
+        queue.pop();
+        const int64_t segment_score = score(segments[index]);
+        if (segment_score <= 0) {
+            continue;
+        }
+        if (!queue.empty() && segment_score < queue.top().first) {
+            queue.emplace(segment_score, index);
+            continue;
+        }
+        const std::string_view segment = segments[index].substr(0, max_size - size);
+        picked.push_back(segment);
+        size += segment.size();
+        for (const uint64_t string : strings) {
+            counts.erase(string);
+        }
+    }
+
+    std::string dictionary;
+    dictionary.reserve(size);
+    for (auto it = picked.rbegin(); it != picked.rend(); ++it) {
+        dictionary.append(*it);
+    }
+    return dictionary;
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Builds a dictionary for compressing values like the samples, at most max_size bytes. Like zstd's cover trainer it
+// picks segments of the samples that contain the most 8 byte strings found in many samples, skipping strings already
+// covered by segments picked before. LZ4 reaches the end of a dictionary with the shortest offsets, so the best
+// segments go last.
+[[nodiscard]] std::string train_save_dictionary(const std::vector<std::string>& samples, size_t max_size);
\ No newline at end of file
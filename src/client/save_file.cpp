@@ -1,105 +1,251 @@
 #include "save_file.hpp"
 
-#include <filesystem>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
 
-#include <cereal/archives/portable_binary.hpp>
 #include <lz4.h>
+#include <lz4hc.h>
 
 #include "../common/assert.hpp"
+#include "binary_archive.hpp"
+#include "column_codec.hpp"
 #include "common.hpp"
+#include "leveldb_backend.hpp"
+#include "region_backend.hpp"
+#include "save_dictionary.hpp"
 
-SaveFile::SaveFile(const size_t max_file_size, const std::string& name)
+// LZ4 only looks back this far, a larger dictionary would not be used
+static constexpr size_t sc_dictionary_size = 64 * 1024;
+static constexpr size_t sc_dictionary_samples_size = 1024 * 1024;
+
+struct SaveFile::Dictionary {
+    std::string data;
+    // Prepared once and attached to per thread streams for each value
+    LZ4_stream_t stream;
+    LZ4_streamHC_t stream_hc;
+};
+
+SaveFile::SaveFile(const size_t max_file_size, const std::string& name, const SaveBackendType backend)
 {
     if (!std::filesystem::exists("save")) {
         std::filesystem::create_directory("save");
     }
-    leveldb::Options db_options;
-    db_options.create_if_missing = true;
-    db_options.compression = leveldb::kNoCompression;
-    db_options.max_file_size = max_file_size;
-    const leveldb::Status db_status = leveldb::DB::Open(db_options, "save/" + name, &m_db);
-    VV_REL_ASSERT(db_status.ok(), "[SaveFile] Leveldb open not ok for " + name)
+    if (backend == SaveBackendType::region) {
+        // Kept apart from a LevelDB save of the same name
+        m_backend = std::make_unique<RegionBackend>("save/" + name + "_regions");
+        m_dictionary_path = "save/" + name + "_regions/dictionary";
+    }
+    else {
+        m_backend = std::make_unique<LevelDbBackend>("save/" + name, max_file_size);
+        // LevelDB leaves files it did not create alone
+        m_dictionary_path = "save/" + name + "/dictionary";
+    }
+    if (std::ifstream file(m_dictionary_path, std::ios::binary); file.is_open()) {
+        set_dictionary(std::string(std::istreambuf_iterator(file), {}));
+    }
 }
-SaveFile::~SaveFile()
+
+SaveFile::~SaveFile() = default;
+
+// Values are stored as cereal wrote ValueData: the endianness flag, the decompressed size, then the compressed bytes
+// as a string, which is their length followed by them. The endianness flag was always 1, which now stands for plain
+// LZ4, other values of it give other ways the bytes were compressed.
+static constexpr size_t sc_value_header_size = 1 + sizeof(uint64_t) + sizeof(uint64_t);
+
+std::optional<std::string_view> SaveFile::find(const std::string_view key)
 {
-    delete m_db;
+    std::optional<std::string_view> value;
+    m_backend->read(key, [&](const std::string_view stored) { value = decompress(stored, key); });
+    return value;
 }
-// ReSharper disable once CppMemberFunctionMayBeConst
-std::optional<std::string> SaveFile::at(const std::string& key)
+
+std::string_view SaveFile::decompress(const std::string_view stored, const std::string_view key) const
 {
-    std::string data;
-    leveldb::Status db_status = m_db->Get(leveldb::ReadOptions(), key, &data);
-    if (db_status.IsNotFound()) {
-        return {};
+    thread_local std::vector<char> decompressed;
+    VV_REL_ASSERT(stored.size() >= sc_value_header_size, "[SaveFile] Invalid value at key: " + std::string(key))
+    const auto format = static_cast<ValueFormat>(stored[0]);
+    uint64_t decompressed_size;
+    uint64_t compressed_size;
+    std::memcpy(&decompressed_size, stored.data() + 1, sizeof(uint64_t));
+    std::memcpy(&compressed_size, stored.data() + 1 + sizeof(uint64_t), sizeof(uint64_t));
+    const std::string_view compressed = stored.substr(sc_value_header_size);
+    VV_REL_ASSERT(
+        compressed_size == compressed.size() && decompressed_size <= std::numeric_limits<int>::max(),
+        "[SaveFile] Invalid value at key: " + std::string(key))
+    decompressed.resize(decompressed_size);
+    int result_size;
+    if (format == ValueFormat::lz4) {
+        result_size = LZ4_decompress_safe(
+            compressed.data(),
+            decompressed.data(),
+            static_cast<int>(compressed.size()),
+            static_cast<int>(decompressed.size()));
     }
-    VV_REL_ASSERT(db_status.ok(), "[SaveFile] Failed to get key: " + key)
-    ValueData value_data;
-    {
-        std::stringstream data_stream(data);
-        cereal::PortableBinaryInputArchive archive_in(data_stream);
-        archive_in(value_data);
+    else {
+        VV_REL_ASSERT(
+            format == ValueFormat::lz4_dictionary || format == ValueFormat::lz4hc_dictionary,
+            "[SaveFile] Unknown value format at key: " + std::string(key))
+        const Dictionary* dictionary = m_dictionary.load(std::memory_order_acquire);
+        VV_REL_ASSERT(dictionary != nullptr, "[SaveFile] Missing dictionary for key: " + std::string(key))
+        result_size = LZ4_decompress_safe_usingDict(
+            compressed.data(),
+            decompressed.data(),
+            static_cast<int>(compressed.size()),
+            static_cast<int>(decompressed.size()),
+            dictionary->data.data(),
+            static_cast<int>(dictionary->data.size()));
     }
+    VV_REL_ASSERT(result_size >= 0, "[SaveFile] Failed to decompress data at key: " + std::string(key))
+    return { decompressed.data(), static_cast<size_t>(result_size) };
+}
 
-    std::vector<char> decompressed_data;
-    decompressed_data.resize(value_data.decompressed_size);
-    int result_size = LZ4_decompress_safe(
-        value_data.data.data(),
-        decompressed_data.data(),
-        static_cast<int>(value_data.data.size()),
-        // ReSharper disable once CppRedundantCastExpression
-        static_cast<int>(decompressed_data.size()));
-    VV_REL_ASSERT(result_size >= 0, "[SaveFile] Failed to decompress data at key: " + key)
-    decompressed_data.resize(result_size);
-
-    return std::string(decompressed_data.begin(), decompressed_data.end());
+void SaveFile::insert(const std::string_view key, const std::string_view value)
+{
+    // Other values are few and unlike columns
+    if (m_dictionary.load(std::memory_order_acquire) == nullptr
+        && (decode_column_key(key).has_value() || decode_section_key(key).has_value())) {
+        add_dictionary_sample(value);
+    }
+    const bool has_dictionary = m_dictionary.load(std::memory_order_acquire) != nullptr;
+    write(key, value, has_dictionary ? ValueFormat::lz4_dictionary : ValueFormat::lz4);
 }
 
-void SaveFile::insert(const std::string& key, const std::string& value)
+void SaveFile::erase(const std::string_view key)
 {
+    m_backend->erase(key);
+}
 
-    std::vector<char> compressed_data(LZ4_compressBound(static_cast<int>(value.size())));
-    const int compressed_size = LZ4_compress_default(
-        value.data(),
-        compressed_data.data(),
-        static_cast<int>(value.size()),
-        // ReSharper disable once CppRedundantCastExpression
-        static_cast<int>(compressed_data.size()));
-    VV_REL_ASSERT(compressed_size > 0, "[SaveFile] LZ4 compression error")
-    compressed_data.resize(compressed_size);
+bool SaveFile::recompress(const std::string_view key)
+{
+    if (m_dictionary.load(std::memory_order_acquire) == nullptr) {
+        return false;
+    }
+    // Decompressed into the thread's buffer, then written once the backend no longer holds the stored value
+    std::optional<std::string_view> value;
+    m_backend->read(key, [&](const std::string_view stored) {
+        if (!stored.empty() && static_cast<ValueFormat>(stored[0]) != ValueFormat::lz4hc_dictionary) {
+            value = decompress(stored, key);
+        }
+    });
+    if (!value.has_value()) {
+        return false;
+    }
+    write(key, *value, ValueFormat::lz4hc_dictionary);
+    return true;
+}
 
-    auto value_data = ValueData { .decompressed_size = value.size(),
-                                  .data = std::string(compressed_data.begin(), compressed_data.end()) };
+void SaveFile::write(const std::string_view key, const std::string_view value, const ValueFormat format)
+{
+    // Initialized once per thread, then reset for each value
+    struct Streams {
+        LZ4_stream_t stream {};
+        LZ4_streamHC_t stream_hc {};
 
-    std::stringstream data_stream;
-    {
-        cereal::PortableBinaryOutputArchive archive_out(data_stream);
-        archive_out(value_data);
+        Streams()
+        {
+            LZ4_initStream(&stream, sizeof(stream));
+            LZ4_initStreamHC(&stream_hc, sizeof(stream_hc));
+        }
+    };
+    thread_local Streams streams;
+
+    // The header is written first and the compressed size patched in once known, so the value is compressed in
+    // place behind it
+    thread_local std::vector<char> stored;
+    stored.clear();
+    BinaryOutputArchive archive(stored);
+    archive(static_cast<uint64_t>(value.size()), uint64_t { 0 });
+    stored[0] = static_cast<char>(format);
+    stored.resize(sc_value_header_size + LZ4_compressBound(static_cast<int>(value.size())));
+    char* compressed = stored.data() + sc_value_header_size;
+    const auto value_size = static_cast<int>(value.size());
+    const auto capacity = static_cast<int>(stored.size() - sc_value_header_size);
+    const Dictionary* dictionary = m_dictionary.load(std::memory_order_acquire);
+    int compressed_size;
+    if (format == ValueFormat::lz4) {
+        compressed_size = LZ4_compress_default(value.data(), compressed, value_size, capacity);
     }
-    if (m_writing_batch) {
-        m_batch.Put(key, data_stream.str());
+    else if (format == ValueFormat::lz4_dictionary) {
+        LZ4_resetStream_fast(&streams.stream);
+        LZ4_attach_dictionary(&streams.stream, &dictionary->stream);
+        compressed_size
+            = LZ4_compress_fast_continue(&streams.stream, value.data(), compressed, value_size, capacity, 1);
     }
     else {
-        const leveldb::Status db_status = m_db->Put(leveldb::WriteOptions(), key, data_stream.str());
-        VV_REL_ASSERT(db_status.ok(), "[SaveFile] Failed to write key: " + key)
+        LZ4_resetStreamHC_fast(&streams.stream_hc, LZ4HC_CLEVEL_DEFAULT);
+        LZ4_attach_HC_dictionary(&streams.stream_hc, &dictionary->stream_hc);
+        compressed_size
+            = LZ4_compress_HC_continue(&streams.stream_hc, value.data(), compressed, value_size, capacity);
     }
+    VV_REL_ASSERT(compressed_size > 0, "[SaveFile] LZ4 compression error")
+    const auto compressed_length = static_cast<uint64_t>(compressed_size);
+    std::memcpy(stored.data() + sc_value_header_size - sizeof(uint64_t), &compressed_length, sizeof(uint64_t));
+
+    m_backend->write(key, std::string_view(stored.data(), sc_value_header_size + compressed_size));
 }
 
-void SaveFile::begin_batch()
+void SaveFile::add_dictionary_sample(const std::string_view value)
+{
+    std::lock_guard lock(m_samples_mutex);
+    if (m_dictionary.load(std::memory_order_acquire) != nullptr) {
+        return;
+    }
+    m_samples.emplace_back(value);
+    m_samples_size += value.size();
+    if (m_samples_size < sc_dictionary_samples_size) {
+        return;
+    }
+    std::string data = train_save_dictionary(m_samples, sc_dictionary_size);
+    m_samples.clear();
+    m_samples.shrink_to_fit();
+    // Written in full before any value refers to it
+    const std::filesystem::path temp_path = m_dictionary_path.string() + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        VV_REL_ASSERT(file.good(), "[SaveFile] Failed to write dictionary")
+    }
+    std::filesystem::rename(temp_path, m_dictionary_path);
+    set_dictionary(std::move(data));
+}
+
+void SaveFile::set_dictionary(std::string data)
 {
-    m_writing_batch = true;
-    clear_batch();
+    auto dictionary = std::make_unique<Dictionary>();
+    dictionary->data = std::move(data);
+    LZ4_initStream(&dictionary->stream, sizeof(dictionary->stream));
+    LZ4_loadDictSlow(&dictionary->stream, dictionary->data.data(), static_cast<int>(dictionary->data.size()));
+    LZ4_initStreamHC(&dictionary->stream_hc, sizeof(dictionary->stream_hc));
+    LZ4_resetStreamHC_fast(&dictionary->stream_hc, LZ4HC_CLEVEL_DEFAULT);
+    LZ4_loadDictHC(&dictionary->stream_hc, dictionary->data.data(), static_cast<int>(dictionary->data.size()));
+    m_dictionary_storage = std::move(dictionary);
+    m_dictionary.store(m_dictionary_storage.get(), std::memory_order_release);
 }
 
-void SaveFile::submit_batch()
+void SaveFile::load_region(
+    const nnm::Vector2i min,
+    const nnm::Vector2i max,
+    const std::function<void(std::string_view key, std::string_view value)>& callable)
 {
-    // ReSharper disable once CppDFAUnusedValue
-    leveldb::Status db_status = m_db->Write(leveldb::WriteOptions(), &m_batch);
-    clear_batch();
-    m_writing_batch = false;
+    m_backend->read_region(min, max, [&](const std::string_view key, const std::string_view stored) {
+        callable(key, decompress(stored, key));
+    });
 }
 
-void SaveFile::clear_batch()
+size_t SaveFile::migrate_legacy_column_keys()
 {
-    m_batch.Clear();
-    m_writing_batch = false;
+    return m_backend->migrate_legacy_column_keys();
 }
+
+void SaveFile::begin_batch()
+{
+    m_backend->begin_batch();
+}
+
+void SaveFile::submit_batch()
+{
+    m_backend->submit_batch();
+}
\ No newline at end of file
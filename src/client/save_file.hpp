@@ -1,20 +1,34 @@
 #pragma once
 
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include <cereal/archives/portable_binary.hpp>
 #include <cereal/cereal.hpp>
 // ReSharper disable once CppUnusedIncludeDirective
 #include <cereal/types/string.hpp>
 
-#include <leveldb/db.h>
-#include <leveldb/write_batch.h>
+#include "common.hpp"
 
+#include <nnm/nnm.hpp>
+
+#include "save_backend.hpp"
+
+// Values are compressed with LZ4 against a dictionary kept in the save, trained from the first columns it stores so the
+// stone, air and light patterns every column repeats are not spelled out in each of them. Values saved before the
+// dictionary exists are compressed on their own.
 class SaveFile {
 public:
-    SaveFile(size_t max_file_size, const std::string& name);
+    // The max file size only applies to LevelDB, region files are sized by the columns they hold
+    SaveFile(size_t max_file_size, const std::string& name, SaveBackendType backend = SaveBackendType::leveldb);
 
     ~SaveFile();
 
@@ -31,12 +45,29 @@ public:
             return {};
         }
         ValueType value(std::forward<Args>(args)...);
+        deserialize(std::move(*value_str), value);
+        return value;
+    }
+
+    // Loads into an existing value, which lets callers deserialize in place instead of moving a copy out
+    template <typename ValueType>
+    static void deserialize(std::string data, ValueType& value)
+    {
+        std::stringstream value_stream(std::move(data));
+        cereal::PortableBinaryInputArchive archive_in(value_stream);
+        archive_in(value);
+    }
+
+    // Same encoding insert stores, before compression
+    template <typename ValueType>
+    static std::string serialize(const ValueType& value)
+    {
+        std::stringstream value_stream;
         {
-            std::stringstream value_stream(*value_str);
-            cereal::PortableBinaryInputArchive archive_in(value_stream);
-            archive_in(value);
+            cereal::PortableBinaryOutputArchive archive_out(value_stream);
+            archive_out(value);
         }
-        return value;
+        return value_stream.str();
     }
 
     template <typename KeyType>
@@ -50,7 +81,14 @@ public:
         return at(key_stream.str());
     }
 
-    std::optional<std::string> at(const std::string& key);
+    std::optional<std::string> at(const std::string& key)
+    {
+        const std::optional<std::string_view> value = find(key);
+        return value.has_value() ? std::optional<std::string>(*value) : std::nullopt;
+    }
+
+    // Decompressed value in a buffer reused by the next read on the same thread, for decoding without copying it
+    [[nodiscard]] std::optional<std::string_view> find(std::string_view key);
 
     template <typename KeyType, typename ValueType>
     void insert(const KeyType& key, const ValueType& value)
@@ -60,35 +98,53 @@ public:
             cereal::PortableBinaryOutputArchive archive_out(key_stream);
             archive_out(key);
         }
-        std::stringstream value_stream;
-        {
-            cereal::PortableBinaryOutputArchive archive_out(value_stream);
-            archive_out(value);
-        }
-        insert(key_stream.str(), value_stream.str());
+        insert(key_stream.str(), serialize(value));
     }
 
-    void insert(const std::string& key, const std::string& value);
+    void insert(std::string_view key, std::string_view value);
+
+    // Does nothing if there is no value
+    void erase(std::string_view key);
+
+    // Compresses the value again with LZ4HC if it was saved with fast compression, which is slow to write but smaller
+    // and as fast to read. Meant for values that are unlikely to be saved again soon. Returns whether it was rewritten.
+    bool recompress(std::string_view key);
+
+    // Visits every saved column from min to max inclusive and its sections saved apart with their decompressed values,
+    // in the order of SaveBackend::read_region. See SaveFile::find for how long a value lives.
+    void load_region(
+        nnm::Vector2i min,
+        nnm::Vector2i max,
+        const std::function<void(std::string_view key, std::string_view value)>& callable);
+
+    // Moves columns saved under the keys used before encode_column_key to their current keys, returns how many.
+    // Does nothing once it has run to the end on the save.
+    size_t migrate_legacy_column_keys();
 
     void begin_batch();
 
     void submit_batch();
 
-    void clear_batch();
-
 private:
-    struct ValueData {
-        size_t decompressed_size;
-        std::string data;
+    struct Dictionary;
 
-        template <class Archive>
-        void serialize(Archive& archive)
-        {
-            archive(decompressed_size, data);
-        }
-    };
+    enum class ValueFormat : uint8_t { lz4 = 1, lz4_dictionary = 2, lz4hc_dictionary = 3 };
+
+    [[nodiscard]] std::string_view decompress(std::string_view stored, std::string_view key) const;
+
+    void write(std::string_view key, std::string_view value, ValueFormat format);
+
+    void add_dictionary_sample(std::string_view value);
+
+    void set_dictionary(std::string data);
 
-    bool m_writing_batch = false;
-    leveldb::WriteBatch m_batch {};
-    leveldb::DB* m_db {};
+    std::filesystem::path m_dictionary_path;
+    std::unique_ptr<SaveBackend> m_backend;
+    // Columns saved before there is a dictionary, guarded by the mutex
+    std::mutex m_samples_mutex;
+    std::vector<std::string> m_samples;
+    size_t m_samples_size = 0;
+    // Set once and never changed after, a value saved with a dictionary can only be read with the same one
+    std::unique_ptr<Dictionary> m_dictionary_storage;
+    std::atomic<const Dictionary*> m_dictionary = nullptr;
 };
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "save_writer.hpp"
+
+#include <iterator>
+
+#include "column_store.hpp"
+#include "save_file.hpp"
+
+SaveWriter::SaveWriter(SaveFile& save)
+    : m_save(&save)
+    , m_thread([this] { run(); })
+{
+}
+
+SaveWriter::~SaveWriter()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+void SaveWriter::submit(std::vector<ColumnSave> columns)
+{
+    if (columns.empty()) {
+        return;
+    }
+    {
+        std::unique_lock lock(m_mutex);
+        // Batches larger than the bound on their own are still taken once nothing waits
+        m_condition.wait(
+            lock, [&] { return m_waiting.empty() || m_waiting.size() + columns.size() <= sc_max_waiting; });
+        for (const ColumnSave& save : columns) {
+            m_pending[save.column.pos()]++;
+        }
+        if (m_waiting.empty()) {
+            m_waiting = std::move(columns);
+        }
+        else {
+            m_waiting.insert(
+                m_waiting.end(), std::make_move_iterator(columns.begin()), std::make_move_iterator(columns.end()));
+        }
+    }
+    m_condition.notify_all();
+}
+
+bool SaveWriter::is_pending(const nnm::Vector2i pos) const
+{
+    std::lock_guard lock(m_mutex);
+    return m_pending.contains(pos);
+}
+
+void SaveWriter::flush()
+{
+    std::unique_lock lock(m_mutex);
+    m_condition.wait(lock, [&] { return m_waiting.empty() && !m_writing; });
+}
+
+std::optional<nnm::Vector2i> SaveWriter::wait_for_work(std::unique_lock<std::mutex>& lock)
+{
+    while (!m_stopping && m_waiting.empty()) {
+        if (m_written.empty()) {
+            m_condition.wait(lock);
+            continue;
+        }
+        const auto [pos, time] = m_written.front();
+        if (const auto it = m_last_written.find(pos); it == m_last_written.end() || it->second != time) {
+            m_written.pop_front();
+            continue;
+        }
+        if (Clock::now() >= time + sc_cold_delay) {
+            m_written.pop_front();
+            m_last_written.erase(pos);
+            return pos;
+        }
+        m_condition.wait_until(lock, time + sc_cold_delay);
+    }
+    return std::nullopt;
+}
+
+void SaveWriter::run()
+{
+    while (true) {
+        std::vector<ColumnSave> batch;
+        std::optional<nnm::Vector2i> cold_pos;
+        {
+            std::unique_lock lock(m_mutex);
+            cold_pos = wait_for_work(lock);
+            if (!cold_pos.has_value()) {
+                if (m_waiting.empty()) {
+                    return;
+                }
+                batch = std::move(m_waiting);
+                m_waiting.clear();
+                m_writing = true;
+            }
+        }
+        // One at a time so a batch submitted meanwhile waits for a single column at most
+        if (cold_pos.has_value()) {
+            recompress_column(*m_save, *cold_pos);
+            continue;
+        }
+        // Room for the next batch while this one is written
+        m_condition.notify_all();
+        std::vector<nnm::Vector2i> written;
+        written.reserve(batch.size());
+        m_save->begin_batch();
+        for (const auto& [column, heights, removed_heights] : batch) {
+            save_column(*m_save, column, heights, removed_heights);
+            written.push_back(column.pos());
+        }
+        m_save->submit_batch();
+        // Snapshots are released here too, not on the main thread
+        batch.clear();
+        {
+            std::lock_guard lock(m_mutex);
+            const Clock::time_point now = Clock::now();
+            for (const nnm::Vector2i pos : written) {
+                if (const auto it = m_pending.find(pos); --it->second == 0) {
+                    m_pending.erase(it);
+                }
+                m_written.emplace_back(pos, now);
+                m_last_written[pos] = now;
+            }
+            m_writing = false;
+        }
+        m_condition.notify_all();
+    }
+}
\ No newline at end of file
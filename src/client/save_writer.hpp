@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+
+#include <nnm/nnm.hpp>
+
+#include "chunk_column.hpp"
+
+class SaveFile;
+
+// A column to save, the heights of its sections that changed since it was last saved, only those are written, and the
+// heights of saved sections it no longer has
+struct ColumnSave {
+    ChunkColumn column;
+    std::vector<int> heights;
+    std::vector<int> removed_heights {};
+};
+
+// Serializes, compresses and writes column snapshots to the save on its own thread. Batches are double buffered: one
+// is written while the next is filled on the main thread. Submitted columns are added to the next batch, submitting
+// only blocks once it holds too many, which bounds the memory held by snapshots when the disk falls behind without
+// stalling on the single columns saved when they are evicted. While idle it recompresses columns that were not saved
+// again for a while with recompress_column.
+class SaveWriter {
+public:
+    explicit SaveWriter(SaveFile& save);
+
+    SaveWriter(const SaveWriter&) = delete;
+
+    SaveWriter& operator=(const SaveWriter&) = delete;
+
+    // Writes everything submitted before returning
+    ~SaveWriter();
+
+    // Columns must be snapshots, nothing else may refer to their sections
+    void submit(std::vector<ColumnSave> columns);
+
+    // Submitted and not written yet, reading it back from the save would return an older version
+    [[nodiscard]] bool is_pending(nnm::Vector2i pos) const;
+
+    // Blocks until everything submitted is written
+    void flush();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Columns the next batch can hold before submitting blocks
+    static constexpr size_t sc_max_waiting = 256;
+
+    // Columns saved again within this are likely to keep changing, recompressing them would be wasted
+    static constexpr Clock::duration sc_cold_delay = std::chrono::seconds(30);
+
+    void run();
+
+    // Waits for the next batch, or returns a column to recompress when one is cold before a batch arrives. Empty if
+    // there is neither because the writer is stopping.
+    [[nodiscard]] std::optional<nnm::Vector2i> wait_for_work(std::unique_lock<std::mutex>& lock);
+
+    SaveFile* m_save;
+    mutable std::mutex m_mutex {};
+    std::condition_variable m_condition {};
+    std::vector<ColumnSave> m_waiting {};
+    bool m_writing = false;
+    bool m_stopping = false;
+    // Number of submitted and unwritten snapshots per column
+    std::unordered_map<nnm::Vector2i, int> m_pending {};
+    // Written columns in the order they were written, an entry is stale if the column was written again after it
+    std::deque<std::pair<nnm::Vector2i, Clock::time_point>> m_written {};
+    std::unordered_map<nnm::Vector2i, Clock::time_point> m_last_written {};
+    // Started last, once everything it uses is constructed
+    std::thread m_thread;
+};
\ No newline at end of file
@@ -0,0 +1,19 @@
+#include "section_pool.hpp"
+
+std::unique_ptr<ChunkData> SectionPool::acquire(const nnm::Vector3i chunk_pos)
+{
+    if (m_free.empty()) {
+        return std::make_unique<ChunkData>(chunk_pos);
+    }
+    std::unique_ptr<ChunkData> chunk = std::move(m_free.back());
+    m_free.pop_back();
+    chunk->recycle(chunk_pos);
+    return chunk;
+}
+
+void SectionPool::release(std::unique_ptr<ChunkData> chunk)
+{
+    if (chunk != nullptr && m_free.size() < sc_max_free) {
+        m_free.push_back(std::move(chunk));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <nnm/nnm.hpp>
+
+#include "chunk_data.hpp"
+
+// Sections of culled columns are kept here and handed out to columns that are generated or loaded next, which
+// saves allocating the section and its buffers again while the player moves
+class SectionPool {
+public:
+    // A section in the same state as a newly constructed one
+    [[nodiscard]] std::unique_ptr<ChunkData> acquire(nnm::Vector3i chunk_pos);
+
+    void release(std::unique_ptr<ChunkData> chunk);
+
+    [[nodiscard]] size_t free_count() const
+    {
+        return m_free.size();
+    }
+
+private:
+    // Retained capacity is up to ~10 KB per section, past this sections are freed instead
+    static constexpr size_t sc_max_free = 1024;
+
+    std::vector<std::unique_ptr<ChunkData>> m_free {};
+};
\ No newline at end of file
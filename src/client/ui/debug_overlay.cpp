@@ -9,6 +9,8 @@ DebugOverlay::DebugOverlay(TextPipeline& text_pipeline)
     , m_build_text(text_pipeline, "", { 0.0f, 0.0f }, 0.8f, c_text_color)
     , m_player_block_text(text_pipeline, "", { 0.0f, 0.0f }, 0.8f, c_text_color)
     , m_player_chunk_text(text_pipeline, "", { 0.0f, 0.0f }, 0.8f, c_text_color)
+    , m_memory_text(text_pipeline, "", { 0.0f, 0.0f }, 0.8f, c_text_color)
+    , m_cache_text(text_pipeline, "", { 0.0f, 0.0f }, 0.8f, c_text_color)
 {
     m_left_column.push_back(&m_fps_text);
     m_left_column.push_back(&m_ms_text);
@@ -16,6 +18,8 @@ DebugOverlay::DebugOverlay(TextPipeline& text_pipeline)
     m_left_column.push_back(&m_build_text);
     m_left_column.push_back(&m_player_block_text);
     m_left_column.push_back(&m_player_chunk_text);
+    m_left_column.push_back(&m_memory_text);
+    m_left_column.push_back(&m_cache_text);
 
 #ifdef NDEBUG
     std::snprintf(m_str_buffer.data(), m_str_buffer.size(), "build: optimized");
@@ -66,3 +70,24 @@ void DebugOverlay::update_player_block_pos(const nnm::Vector3i pos)
         m_str_buffer.data(), m_str_buffer.size(), "chunk: [%d, %d, %d]", chunk_pos.x, chunk_pos.y, chunk_pos.z);
     m_player_chunk_text.update(m_str_buffer.data());
 }
+
+void DebugOverlay::update_memory(
+    const size_t usage, const size_t budget, const size_t cache_usage, const size_t cache_budget)
+{
+    constexpr float mb = 1024.0f * 1024.0f;
+    std::snprintf(
+        m_str_buffer.data(),
+        m_str_buffer.size(),
+        "columns: %.1f / %.0f MB",
+        static_cast<float>(usage) / mb,
+        static_cast<float>(budget) / mb);
+    m_memory_text.update(m_str_buffer.data());
+
+    std::snprintf(
+        m_str_buffer.data(),
+        m_str_buffer.size(),
+        "cache: %.1f / %.0f MB",
+        static_cast<float>(cache_usage) / mb,
+        static_cast<float>(cache_budget) / mb);
+    m_cache_text.update(m_str_buffer.data());
+}
\ No newline at end of file
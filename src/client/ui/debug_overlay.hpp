@@ -18,6 +18,8 @@ public:
 
     void update_player_block_pos(nnm::Vector3i pos);
 
+    void update_memory(size_t usage, size_t budget, size_t cache_usage, size_t cache_budget);
+
 private:
     const nnm::Vector3f c_text_color = { 0.0f, 0.0f, 0.0f };
 
@@ -34,4 +36,6 @@ private:
     TextBuffer m_build_text;
     TextBuffer m_player_block_text;
     TextBuffer m_player_chunk_text;
+    TextBuffer m_memory_text;
+    TextBuffer m_cache_text;
 };
\ No newline at end of file
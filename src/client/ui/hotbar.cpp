@@ -1,5 +1,6 @@
 #include "hotbar.hpp"
 
+#include "../block_registry.hpp"
 #include "../common.hpp"
 
 Hotbar::Hotbar(UIPipeline& ui_pipeline)
@@ -100,7 +101,7 @@ std::pair<mve::VertexData, std::vector<uint32_t>> Hotbar::create_item_mesh(const
 {
     constexpr auto size = nnm::Vector2f::all(14 * 5);
     auto [top_left, top_right, bottom_right, bottom_left]
-        = uvs_from_atlas({ 4, 4 }, block_uv(block_type, Direction::front));
+        = uvs_from_atlas(block_atlas_size(), block_uv(block_type, Direction::front));
 
     mve::VertexData data(UIPipeline::vertex_layout());
     data.push_back(nnm::Vector3(-0.5f * size.x, -1.0f * size.y, 0.0f));
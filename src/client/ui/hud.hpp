@@ -20,6 +20,12 @@ public:
         m_debug_overlay.update_fps(fps);
     }
 
+    void update_debug_memory(
+        const size_t usage, const size_t budget, const size_t cache_usage, const size_t cache_budget)
+    {
+        m_debug_overlay.update_memory(usage, budget, cache_usage, cache_budget);
+    }
+
     void update_debug_gpu_name(const std::string& gpu)
     {
         m_debug_overlay.update_gpu_name(gpu);
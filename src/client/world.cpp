@@ -1,6 +1,7 @@
 #include "world.hpp"
 
 #include "../common/logger.hpp"
+#include "block_accessor.hpp"
 #include "chunk_data.hpp"
 #include "common.hpp"
 #include "lighting.hpp"
@@ -120,8 +121,9 @@ void trigger_place_block(
     const std::vector<nnm::Vector3i> blocks
         = ray_blocks(camera.position(), camera.position() + camera.direction() * 10.0f);
     const Ray ray { camera.position(), camera.direction().normalize() };
+    BlockAccessor accessor(world_data);
     for (const nnm::Vector3i block_pos : blocks) {
-        if (std::optional<uint8_t> block = world_data.block_at(block_pos); !block.has_value() || block.value() == 0) {
+        if (std::optional<uint8_t> block = accessor.block_at(block_pos); !block.has_value() || block.value() == 0) {
             continue;
         }
         BoundingBox bb { { nnm::Vector3f(block_pos) - nnm::Vector3f(0.5f, 0.5f, 0.5f) },
@@ -137,7 +139,8 @@ void trigger_place_block(
                 collides(broadphase_box, place_bb)) {
                 break;
             }
-            if (!world_data.block_at(place_pos).has_value() || world_data.block_at(place_pos).value() != 0) {
+            if (const std::optional<uint8_t> place_block = accessor.block_at(place_pos);
+                !place_block.has_value() || place_block.value() != 0) {
                 break;
             }
             world_data.set_block(place_pos, block_type);
@@ -145,9 +148,7 @@ void trigger_place_block(
 
             refresh_lighting(world_data, chunk_pos);
 
-            for_2d({ -1, -1 }, { 2, 2 }, [&](const nnm::Vector2i& surround_pos) {
-                chunk_controller.queue_recreate_mesh(nnm::Vector2i(chunk_pos.x, chunk_pos.y) + surround_pos);
-            });
+            chunk_controller.queue_dirty_meshes(world_data, chunk_pos);
             break;
         }
     }
@@ -158,8 +159,9 @@ void trigger_break_block(const Player& camera, ChunkController& chunk_controller
     const std::vector<nnm::Vector3i> blocks
         = ray_blocks(camera.position(), camera.position() + camera.direction() * 10.0f);
     const Ray ray { camera.position(), camera.direction().normalize() };
+    BlockAccessor accessor(world_data);
     for (const nnm::Vector3i block_pos : blocks) {
-        if (std::optional<uint8_t> block = world_data.block_at(block_pos); !block.has_value() || block.value() == 0) {
+        if (std::optional<uint8_t> block = accessor.block_at(block_pos); !block.has_value() || block.value() == 0) {
             continue;
         }
         BoundingBox bb { { nnm::Vector3f(block_pos) - nnm::Vector3f(0.5f, 0.5f, 0.5f) },
@@ -171,9 +173,7 @@ void trigger_break_block(const Player& camera, ChunkController& chunk_controller
             world_data.set_block_local(chunk_pos, local_pos, 0);
             refresh_lighting(world_data, chunk_pos);
 
-            for_2d({ -1, -1 }, { 2, 2 }, [&](const nnm::Vector2i& surround_pos) {
-                chunk_controller.queue_recreate_mesh(nnm::Vector2i(chunk_pos.x, chunk_pos.y) + surround_pos);
-            });
+            chunk_controller.queue_dirty_meshes(world_data, chunk_pos);
             break;
         }
     }
@@ -186,6 +186,11 @@ void World::update(mve::Window& window, const float blend, mve::Renderer& render
     }
     if (m_hud.is_debug_enabled()) {
         m_hud.update_debug_player_block_pos(m_player.block_position());
+        m_hud.update_debug_memory(
+            m_world_data.memory_usage(),
+            m_world_data.memory_budget(),
+            m_world_data.cache_memory_usage(),
+            m_world_data.cache_budget());
     }
 
     m_player.update(window, m_focus == FocusState::world);
@@ -220,8 +225,9 @@ void World::update(mve::Window& window, const float blend, mve::Renderer& render
         = ray_blocks(m_player.position(), m_player.position() + m_player.direction() * 10.0f);
     const Ray ray { m_player.position(), m_player.direction().normalize() };
     m_world_renderer.hide_selection();
+    BlockAccessor accessor(m_world_data);
     for (const nnm::Vector3i block_pos : blocks) {
-        if (std::optional<uint8_t> block = m_world_data.block_at(block_pos); !block.has_value() || block.value() == 0) {
+        if (std::optional<uint8_t> block = accessor.block_at(block_pos); !block.has_value() || block.value() == 0) {
             continue;
         }
         BoundingBox bb { { nnm::Vector3f(block_pos) - nnm::Vector3f(0.5f, 0.5f, 0.5f) },
@@ -233,6 +239,7 @@ void World::update(mve::Window& window, const float blend, mve::Renderer& render
         }
     }
 
+    m_chunk_controller.prefetch(m_world_data, m_player);
     m_chunk_controller.update(
         m_world_data, m_world_generator, m_world_renderer, chunk_pos_from_block_pos(m_player.block_position()));
 }
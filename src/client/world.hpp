@@ -33,6 +33,26 @@ public:
 
     void draw();
 
+    void set_memory_budget_mb(const int megabytes)
+    {
+        m_world_data.set_memory_budget(static_cast<size_t>(megabytes) * 1024 * 1024);
+    }
+
+    [[nodiscard]] int memory_budget_mb() const
+    {
+        return static_cast<int>(m_world_data.memory_budget() / (1024 * 1024));
+    }
+
+    void set_cache_budget_mb(const int megabytes)
+    {
+        m_world_data.set_cache_budget(static_cast<size_t>(megabytes) * 1024 * 1024);
+    }
+
+    [[nodiscard]] int cache_budget_mb() const
+    {
+        return static_cast<int>(m_world_data.cache_budget() / (1024 * 1024));
+    }
+
     void update_debug_fps(const int fps)
     {
         m_hud.update_debug_fps(fps);
@@ -1,17 +1,87 @@
 #include "world_data.hpp"
 
+#include "column_codec.hpp"
+#include "column_store.hpp"
 #include "common.hpp"
 
-#include <ranges>
+WorldData::ColumnLock::ColumnLock(
+    const WorldData& world_data, const nnm::Vector2i min, const nnm::Vector2i max, const LockMode mode)
+    : m_world_data(&world_data)
+    , m_mode(mode)
+{
+    // shared_mutex may prefer readers, the turnstile keeps new readers out while the main thread waits to write
+    std::lock_guard turnstile(world_data.m_lock_turnstile);
+    if (mode == LockMode::read) {
+        world_data.m_index_mutex.lock_shared();
+    }
+    // A shard mask instead of the columns themselves keeps the locking order ascending and each shard locked once
+    for (int x = min.x; x <= std::min(max.x, min.x + 7); ++x) {
+        for (int y = min.y; y <= std::min(max.y, min.y + 7); ++y) {
+            m_shards |= uint64_t { 1 } << column_lock_shard({ x, y });
+        }
+    }
+    for (int shard = 0; shard < sc_column_lock_shards; ++shard) {
+        if ((m_shards >> shard & 1) == 0) {
+            continue;
+        }
+        if (mode == LockMode::read) {
+            world_data.m_column_mutexes[shard].lock_shared();
+        }
+        else {
+            world_data.m_column_mutexes[shard].lock();
+        }
+    }
+}
+
+WorldData::ColumnLock::~ColumnLock()
+{
+    for (int shard = sc_column_lock_shards - 1; shard >= 0; --shard) {
+        if ((m_shards >> shard & 1) == 0) {
+            continue;
+        }
+        if (m_mode == LockMode::read) {
+            m_world_data->m_column_mutexes[shard].unlock_shared();
+        }
+        else {
+            m_world_data->m_column_mutexes[shard].unlock();
+        }
+    }
+    if (m_mode == LockMode::read) {
+        m_world_data->m_index_mutex.unlock_shared();
+    }
+}
+
+std::unique_lock<std::shared_mutex> WorldData::lock_index()
+{
+    std::lock_guard turnstile(m_lock_turnstile);
+    return std::unique_lock(m_index_mutex);
+}
 
 WorldData::WorldData()
-    : m_save(16 * 1024 * 1024, "world_data")
+    : m_save(16 * 1024 * 1024, "world_data", sc_save_backend)
     , m_player_chunk(nnm::Vector2i(0, 0))
 {
+    // Before anything reads the save, saves from older versions keyed columns in an order unrelated to position
+    m_save.migrate_legacy_column_keys();
+}
+
+void WorldData::prefetch_columns(const std::vector<nnm::Vector2i>& positions)
+{
+    // The save data of these could still change before they are loaded, and cached ones decode quickly anyway
+    std::vector<nnm::Vector2i> requests;
+    requests.reserve(positions.size());
+    for (const nnm::Vector2i pos : positions) {
+        if (!m_residency.contains(pos) && !m_column_cache.contains(pos) && !m_save_writer.is_pending(pos)) {
+            requests.push_back(pos);
+        }
+    }
+    m_column_prefetcher.request(requests);
 }
 
 void WorldData::queue_save_chunk(const nnm::Vector2i pos)
 {
+    // Queued on every edit, which is also when a column's size changes
+    update_memory_usage(pos);
     m_save_queue.insert(pos);
     if (m_save_queue.size() > 50) {
         process_save_queue();
@@ -19,21 +89,19 @@ void WorldData::queue_save_chunk(const nnm::Vector2i pos)
 }
 void WorldData::set_player_chunk(const nnm::Vector2i chunk_pos)
 {
-    const nnm::Vector2i prev = m_player_chunk;
     m_player_chunk = chunk_pos;
-    if (m_player_chunk != prev) {
-        sort_chunks();
-    }
+    m_column_distances.set_center(chunk_pos);
 }
 std::optional<nnm::Vector2i> WorldData::try_cull_chunk(const float distance)
 {
-    if (nnm::Vector2i furthest_chunk = m_sorted_chunks[m_sorted_chunks.size() - 1];
-        nnm::Vector2f(furthest_chunk).distance(nnm::Vector2f(m_player_chunk)) > distance) {
-        if (m_save_queue.contains(furthest_chunk)) {
-            process_save_queue();
-        }
-        m_chunk_columns.erase(furthest_chunk);
-        m_sorted_chunks.pop_back();
+    m_cull_distance = distance;
+    if (const std::optional<nnm::Vector2i> furthest_chunk = m_column_distances.farthest();
+        furthest_chunk.has_value()
+        && nnm::Vector2f(*furthest_chunk).distance(nnm::Vector2f(m_player_chunk)) > distance) {
+        m_column_distances.erase(*furthest_chunk);
+        update_memory_usage(*furthest_chunk);
+        m_residency.at(*furthest_chunk).culled = m_culled_columns.insert(m_culled_columns.end(), *furthest_chunk);
+        evict_to_budget();
         return furthest_chunk;
     }
     return {};
@@ -41,60 +109,316 @@ std::optional<nnm::Vector2i> WorldData::try_cull_chunk(const float distance)
 
 WorldData::~WorldData()
 {
-    for (auto& col : m_chunk_columns | std::views::values) {
-        queue_save_chunk(col.pos());
-    }
+    m_chunk_columns.for_each([&](const nnm::Vector2i pos, const ChunkColumn&) { queue_save_chunk(pos); });
     process_save_queue();
 }
 
 void WorldData::create_or_load_chunk(const nnm::Vector2i chunk_pos)
 {
+    if (ColumnResidency* residency = m_residency.find(chunk_pos); residency != nullptr) {
+        // Still resident from when it was last in view, no need to go through the save
+        if (residency->culled.has_value()) {
+            m_culled_columns.erase(*residency->culled);
+            residency->culled.reset();
+            m_column_distances.insert(chunk_pos);
+        }
+        return;
+    }
     if (!try_load_chunk_column_from_save(chunk_pos)) {
         create_chunk_column(chunk_pos);
     }
 }
 
+void WorldData::copy_neighborhood(const nnm::Vector3i chunk_pos, ChunkNeighborhood& neighborhood) const
+{
+    copy_neighborhood(snapshot_neighborhood(chunk_pos), neighborhood);
+}
+
+void WorldData::copy_neighborhood(const NeighborhoodSnapshot& snapshot, ChunkNeighborhood& neighborhood)
+{
+    neighborhood.set_chunk_pos(snapshot.chunk_pos);
+    int i = 0;
+    for_2d({ -1, -1 }, { 2, 2 }, [&](const nnm::Vector2i col_offset) {
+        for (int z = -1; z <= 1; ++z, ++i) {
+            const nnm::Vector3i offset { col_offset.x, col_offset.y, z };
+            if (!snapshot.column_loaded[i]) {
+                neighborhood.fill_section(offset, 0, ChunkData::pack_light(0, 0));
+            }
+            else if (snapshot.sections[i].has_value()) {
+                neighborhood.copy_section(offset, *snapshot.sections[i]);
+            }
+            else {
+                neighborhood.fill_section(
+                    offset,
+                    0,
+                    ChunkData::pack_light(
+                        ChunkColumn::sky_light_value(LightChannel::sky),
+                        ChunkColumn::sky_light_value(LightChannel::block)));
+            }
+        }
+    });
+}
+
+NeighborhoodSnapshot WorldData::snapshot_neighborhood(const nnm::Vector3i chunk_pos) const
+{
+    NeighborhoodSnapshot snapshot { .chunk_pos = chunk_pos };
+    const ColumnLock lock
+        = lock_columns({ chunk_pos.x - 1, chunk_pos.y - 1 }, { chunk_pos.x + 1, chunk_pos.y + 1 }, LockMode::read);
+    int i = 0;
+    for_2d({ -1, -1 }, { 2, 2 }, [&](const nnm::Vector2i col_offset) {
+        const ChunkColumn* column = m_chunk_columns.find({ chunk_pos.x + col_offset.x, chunk_pos.y + col_offset.y });
+        for (int z = -1; z <= 1; ++z, ++i) {
+            snapshot.column_loaded[i] = column != nullptr;
+            if (column == nullptr) {
+                continue;
+            }
+            if (const ChunkData* chunk = column->find_chunk_data(chunk_pos.z + z); chunk != nullptr) {
+                snapshot.sections[i] = chunk->snapshot();
+            }
+        }
+    });
+    return snapshot;
+}
+
+std::array<uint64_t, 27> WorldData::neighborhood_versions(const nnm::Vector3i chunk_pos) const
+{
+    // Section versions never go below 1 << 32, which leaves 0 and 1 free for unloaded columns and missing sections
+    std::array<uint64_t, 27> versions {};
+    const ColumnLock lock
+        = lock_columns({ chunk_pos.x - 1, chunk_pos.y - 1 }, { chunk_pos.x + 1, chunk_pos.y + 1 }, LockMode::read);
+    int i = 0;
+    for_2d({ -1, -1 }, { 2, 2 }, [&](const nnm::Vector2i col_offset) {
+        const ChunkColumn* column = m_chunk_columns.find({ chunk_pos.x + col_offset.x, chunk_pos.y + col_offset.y });
+        for (int z = -1; z <= 1; ++z) {
+            if (column == nullptr) {
+                versions[i++] = 0;
+            }
+            else if (const ChunkData* chunk = column->find_chunk_data(chunk_pos.z + z); chunk != nullptr) {
+                versions[i++] = chunk->version();
+            }
+            else {
+                versions[i++] = 1;
+            }
+        }
+    });
+    return versions;
+}
+
 void WorldData::create_chunk_column(nnm::Vector2i chunk_pos)
 {
-    if (auto [_, inserted] = m_chunk_columns.insert({ chunk_pos, ChunkColumn(chunk_pos) }); inserted) {
-        insert_sorted(m_sorted_chunks, chunk_pos, compare_from_player);
+    if (m_chunk_columns.contains(chunk_pos)) {
+        return;
     }
+    evict_occupant(chunk_pos);
+    {
+        const std::unique_lock lock = lock_index();
+        m_chunk_columns.try_emplace(chunk_pos, chunk_pos, m_section_pool);
+    }
+    m_column_distances.insert(chunk_pos);
+    add_residency(chunk_pos);
 }
 
 void WorldData::process_save_queue()
 {
-    m_save.begin_batch();
+    // Only the snapshots are taken here, serializing and writing happens on the writer's thread
+    std::vector<ColumnSave> snapshots;
     for (nnm::Vector2i pos : m_save_queue) {
-        if (m_chunk_columns.contains(pos)) {
-            m_save.insert<nnm::Vector2i, ChunkColumn>(pos, m_chunk_columns.at(pos));
+        const ChunkColumn* column = m_chunk_columns.find(pos);
+        if (column == nullptr) {
+            continue;
+        }
+        // Columns get queued on every edit and again on shutdown, most have not changed since they were written
+        const uint64_t version = column->version();
+        const auto [saved, inserted] = m_saved_versions.try_emplace(pos);
+        if (!inserted && saved->second.column == version) {
+            continue;
         }
+        saved->second.column = version;
+        // An edit usually touches one or two sections, the rest are left as they are in the save
+        std::vector<int> heights;
+        column->for_each_chunk_data([&](const ChunkData& chunk) {
+            const int height = chunk.position().z;
+            if (const auto [section, new_section] = saved->second.sections.try_emplace(height, chunk.version());
+                new_section || section->second != chunk.version()) {
+                section->second = chunk.version();
+                heights.push_back(height);
+            }
+        });
+        // Their values would otherwise stay in the save with nothing listing them
+        std::vector<int> removed_heights;
+        std::erase_if(saved->second.sections, [&](const auto& section) {
+            if (column->contains_chunk_data(section.first)) {
+                return false;
+            }
+            removed_heights.push_back(section.first);
+            return true;
+        });
+        snapshots.push_back({ column->snapshot(), std::move(heights), std::move(removed_heights) });
     }
-    m_save.submit_batch();
+    m_save_writer.submit(std::move(snapshots));
     m_save_queue.clear();
 }
 
 void WorldData::remove_chunk_column(const nnm::Vector2i chunk_pos)
 {
+    const ChunkColumn* column = m_chunk_columns.find(chunk_pos);
+    // Light spreading in from neighbours changes columns without queueing them, the cache entry must not be newer
+    // than the save
+    if (column != nullptr) {
+        if (const auto saved = m_saved_versions.find(chunk_pos);
+            saved == m_saved_versions.end() || saved->second.column != column->version()) {
+            m_save_queue.insert(chunk_pos);
+        }
+    }
     if (m_save_queue.contains(chunk_pos)) {
         process_save_queue();
     }
-    m_chunk_columns.erase(chunk_pos);
-    std::erase(m_sorted_chunks, chunk_pos);
+    if (column != nullptr) {
+        m_column_cache.insert(chunk_pos, encode_column(*column));
+    }
+    {
+        const std::unique_lock lock = lock_index();
+        m_chunk_columns.erase(chunk_pos);
+    }
+    m_saved_versions.erase(chunk_pos);
+    m_column_distances.erase(chunk_pos);
+    if (const ColumnResidency* residency = m_residency.find(chunk_pos); residency != nullptr) {
+        m_memory_usage -= residency->memory_usage;
+        if (residency->culled.has_value()) {
+            m_culled_columns.erase(*residency->culled);
+        }
+        m_residency.erase(chunk_pos);
+    }
 }
 
-void WorldData::sort_chunks()
+void WorldData::add_residency(const nnm::Vector2i chunk_pos)
 {
-    std::ranges::sort(m_sorted_chunks, compare_from_player);
+    m_residency.try_emplace(chunk_pos);
+    update_memory_usage(chunk_pos);
+    evict_to_budget();
+}
+
+void WorldData::update_memory_usage(const nnm::Vector2i chunk_pos)
+{
+    ColumnResidency* residency = m_residency.find(chunk_pos);
+    const ChunkColumn* column = m_chunk_columns.find(chunk_pos);
+    if (residency == nullptr || column == nullptr) {
+        return;
+    }
+    m_memory_usage -= residency->memory_usage;
+    residency->memory_usage = column->memory_usage();
+    m_memory_usage += residency->memory_usage;
+}
+
+void WorldData::evict_occupant(const nnm::Vector2i chunk_pos)
+{
+    // Columns left behind far away would otherwise keep doubling the grid. Only a few are culled per frame, so a
+    // fast moving player can leave columns in view behind too, ChunkController drops its state for those as far.
+    if (const std::optional<nnm::Vector2i> occupant = m_residency.occupant(chunk_pos);
+        occupant.has_value() && *occupant != chunk_pos
+        && (m_residency.at(*occupant).culled.has_value()
+            || nnm::Vector2f(*occupant).distance(nnm::Vector2f(m_player_chunk)) > 2.0f * m_cull_distance)) {
+        remove_chunk_column(*occupant);
+    }
+}
+
+void WorldData::evict_to_budget()
+{
+    if (m_deferring_eviction) {
+        return;
+    }
+    // Columns in view are never evicted, the budget can be exceeded by them alone
+    while (m_memory_usage > m_memory_budget && !m_culled_columns.empty()) {
+        remove_chunk_column(m_culled_columns.front());
+    }
 }
 
 bool WorldData::try_load_chunk_column_from_save(nnm::Vector2i chunk_pos)
 {
-    std::optional<ChunkColumn> data = m_save.at<nnm::Vector2i, ChunkColumn>(chunk_pos);
-    if (!data.has_value()) {
-        return false;
+    if (m_chunk_columns.contains(chunk_pos)) {
+        return true;
+    }
+    // Filled outside the index lock so readers are not held up by decoding, moving it in afterwards only moves
+    // the section pointers
+    ChunkColumn column(chunk_pos, m_section_pool);
+    std::vector<int> unsaved_heights;
+    if (std::optional<ChunkColumn> prefetched; m_column_prefetcher.take(chunk_pos, prefetched, unsaved_heights)) {
+        if (!prefetched.has_value()) {
+            return false;
+        }
+        column = std::move(*prefetched);
+        column.set_pool(m_section_pool);
     }
-    if (auto [_, inserted] = m_chunk_columns.insert({ chunk_pos, *data }); inserted) {
-        insert_sorted(m_sorted_chunks, chunk_pos, compare_from_player);
+    else if (const std::optional<std::string> cached = m_column_cache.take(chunk_pos); cached.has_value()) {
+        decode_column(*cached, column);
     }
+    else {
+        if (m_save_writer.is_pending(chunk_pos)) {
+            m_save_writer.flush();
+        }
+        if (!load_column(m_save, chunk_pos, column, unsaved_heights)) {
+            return false;
+        }
+    }
+    add_loaded_column(std::move(column), unsaved_heights);
     return true;
+}
+
+int WorldData::load_region(const nnm::Vector2i min, const nnm::Vector2i max)
+{
+    // Writes still pending in the region would otherwise be read back at an older version
+    m_save_writer.flush();
+    // The scan reads the save as it was when it started, so nothing in the region may be evicted and written during
+    // it. Grid slot collisions only evict columns further away than the region is wide.
+    m_deferring_eviction = true;
+    int count = 0;
+    const auto add = [&](ChunkColumn column, const std::vector<int>& unsaved_heights) {
+        add_loaded_column(std::move(column), unsaved_heights);
+        count++;
+    };
+    const auto filter = [&](const nnm::Vector2i pos) {
+        // Cached columns are newer than the save or the same, either way cheaper to load from the cache later
+        if (m_residency.contains(pos) || m_column_cache.contains(pos)) {
+            return false;
+        }
+        // A prefetched copy must not outlive the column being loaded here, it would be stale once this one changes
+        std::optional<ChunkColumn> prefetched;
+        if (std::vector<int> unsaved_heights;
+            m_column_prefetcher.take(pos, prefetched, unsaved_heights) && prefetched.has_value()) {
+            prefetched->set_pool(m_section_pool);
+            add(std::move(*prefetched), unsaved_heights);
+            return false;
+        }
+        return true;
+    };
+    load_columns(m_save, min, max, m_section_pool, m_relight_pool, filter, add);
+    m_deferring_eviction = false;
+    evict_to_budget();
+    return count;
+}
+
+void WorldData::add_loaded_column(ChunkColumn column, const std::vector<int>& unsaved_heights)
+{
+    const nnm::Vector2i chunk_pos = column.pos();
+    SavedVersions& saved = m_saved_versions[chunk_pos];
+    saved.column = column.version();
+    saved.sections.clear();
+    column.for_each_chunk_data([&](const ChunkData& chunk) { saved.sections[chunk.position().z] = chunk.version(); });
+    // Left out so the save queue writes them, loads never write to the save themselves
+    if (!unsaved_heights.empty()) {
+        saved.column.reset();
+        for (const int height : unsaved_heights) {
+            saved.sections.erase(height);
+        }
+    }
+    evict_occupant(chunk_pos);
+    {
+        const std::unique_lock lock = lock_index();
+        m_chunk_columns.try_emplace(chunk_pos, std::move(column));
+    }
+    m_column_distances.insert(chunk_pos);
+    add_residency(chunk_pos);
+    if (!unsaved_heights.empty()) {
+        queue_save_chunk(chunk_pos);
+    }
 }
\ No newline at end of file
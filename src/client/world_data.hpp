@@ -1,21 +1,68 @@
 #pragma once
 
-#include <functional>
+#include <array>
+#include <limits>
+#include <list>
+#include <mutex>
 #include <optional>
 #include <set>
+#include <shared_mutex>
 #include <unordered_map>
 
+#include <BS_thread_pool.hpp>
+
 #include "common.hpp"
 
 #include <nnm/nnm.hpp>
 
 #include "chunk_column.hpp"
 #include "chunk_data.hpp"
+#include "column_cache.hpp"
+#include "column_grid.hpp"
+#include "column_prefetcher.hpp"
+#include "distance_buckets.hpp"
+#include "chunk_neighborhood.hpp"
 #include "save_file.hpp"
+#include "save_writer.hpp"
+#include "section_pool.hpp"
 
 class WorldGenerator;
+
+// The sections around a chunk pinned at their current versions, in the order of WorldData::neighborhood_versions.
+// Holding one never blocks edits, written sections copy their storage away from it instead.
+struct NeighborhoodSnapshot {
+    nnm::Vector3i chunk_pos;
+    std::array<bool, 27> column_loaded {};
+    std::array<std::optional<ChunkData>, 27> sections {};
+};
+
+// Only the main thread writes, other threads may read at the same time. Column lookups are guarded by an index lock
+// that the main thread takes exclusively to create and remove columns. Column contents are guarded by reader/writer
+// locks sharded by column position. Writes through WorldData lock for themselves, and code writing through column or
+// section references holds lock_columns for writing over what it touches. Other threads read through
+// copy_neighborhood, snapshot_neighborhood and neighborhood_versions, which lock for themselves, or hold lock_columns
+// for reading. The main thread reads without locks. Locks are taken index first and shards in ascending order, so
+// while holding a column lock the main thread must not create or remove columns or call the locking writes.
 class WorldData {
 public:
+    enum class LockMode { read, write };
+
+    class ColumnLock {
+    public:
+        ColumnLock(const WorldData& world_data, nnm::Vector2i min, nnm::Vector2i max, LockMode mode);
+
+        ColumnLock(const ColumnLock&) = delete;
+
+        ColumnLock& operator=(const ColumnLock&) = delete;
+
+        ~ColumnLock();
+
+    private:
+        const WorldData* m_world_data;
+        LockMode m_mode;
+        uint64_t m_shards = 0;
+    };
+
     WorldData();
 
     ~WorldData();
@@ -25,32 +72,29 @@ public:
     [[nodiscard]] std::optional<uint8_t> block_at(const nnm::Vector3i block_pos) const
     {
         nnm::Vector3i chunk_pos = chunk_pos_from_block_pos(block_pos);
-        if (chunk_pos.z < -10 || chunk_pos.z >= 10) {
+        const ChunkColumn* column = m_chunk_columns.find({ chunk_pos.x, chunk_pos.y });
+        if (column == nullptr) {
             return {};
         }
-        if (!m_chunk_columns.contains({ chunk_pos.x, chunk_pos.y })) {
-            return {};
-        }
-        return m_chunk_columns.at({ chunk_pos.x, chunk_pos.y }).get_block(block_pos);
+        return column->get_block(block_pos);
     }
 
-    void set_lighting(const nnm::Vector3i pos, const uint8_t val)
+    void set_light(const nnm::Vector3i pos, const LightChannel channel, const uint8_t val)
     {
         nnm::Vector3i chunk_pos = chunk_pos_from_block_pos(pos);
         VV_DEB_ASSERT(m_chunk_columns.contains({ chunk_pos.x, chunk_pos.y }), "[WorldData] Invalid chunk");
-        m_chunk_columns.at({ chunk_pos.x, chunk_pos.y }).set_lighting(pos, val);
+        const ColumnLock lock = lock_column({ chunk_pos.x, chunk_pos.y });
+        m_chunk_columns.at({ chunk_pos.x, chunk_pos.y }).set_light(pos, channel, val);
     }
 
     [[nodiscard]] std::optional<uint8_t> lighting_at(const nnm::Vector3i block_pos) const
     {
         nnm::Vector3i chunk_pos = chunk_pos_from_block_pos(block_pos);
-        if (chunk_pos.z < -10 || chunk_pos.z >= 10) {
-            return {};
-        }
-        if (!m_chunk_columns.contains({ chunk_pos.x, chunk_pos.y })) {
+        const ChunkColumn* column = m_chunk_columns.find({ chunk_pos.x, chunk_pos.y });
+        if (column == nullptr) {
             return {};
         }
-        return m_chunk_columns.at({ chunk_pos.x, chunk_pos.y }).lighting_at(block_pos);
+        return column->lighting_at(block_pos);
     }
 
     [[nodiscard]] uint8_t block_at_local(nnm::Vector3i chunk_pos, const nnm::Vector3i block_pos) const
@@ -87,14 +131,21 @@ public:
     {
         nnm::Vector3i chunk_pos = chunk_pos_from_block_pos(block_pos);
         VV_DEB_ASSERT(m_chunk_columns.contains({ chunk_pos.x, chunk_pos.y }), "[WorldData] Invalid chunk");
-        m_chunk_columns.at({ chunk_pos.x, chunk_pos.y }).set_block(block_pos, type);
+        {
+            const ColumnLock lock = lock_column({ chunk_pos.x, chunk_pos.y });
+            m_chunk_columns.at({ chunk_pos.x, chunk_pos.y }).set_block(block_pos, type);
+        }
         queue_save_chunk({ chunk_pos.x, chunk_pos.y });
     }
 
     void set_block_local(nnm::Vector3i chunk_pos, const nnm::Vector3i block_pos, const uint8_t type)
     {
         VV_DEB_ASSERT(m_chunk_columns.contains({ chunk_pos.x, chunk_pos.y }), "[WorldData] Invalid chunk");
-        m_chunk_columns.at({ chunk_pos.x, chunk_pos.y }).set_block(block_local_to_world(chunk_pos, block_pos), type);
+        {
+            const ColumnLock lock = lock_column({ chunk_pos.x, chunk_pos.y });
+            ChunkColumn& column = m_chunk_columns.at({ chunk_pos.x, chunk_pos.y });
+            column.set_block(block_local_to_world(chunk_pos, block_pos), type);
+        }
         queue_save_chunk({ chunk_pos.x, chunk_pos.y });
     }
 
@@ -110,23 +161,53 @@ public:
         return m_chunk_columns.at(chunk_pos);
     }
 
+    // Null if the column is not loaded
+    [[nodiscard]] const ChunkColumn* find_column(const nnm::Vector2i chunk_pos) const
+    {
+        return m_chunk_columns.find(chunk_pos);
+    }
+
     [[nodiscard]] const ChunkData& chunk_data_at(nnm::Vector3i chunk_pos) const
     {
         VV_DEB_ASSERT(m_chunk_columns.contains({ chunk_pos.x, chunk_pos.y }), "[WorldData] Invalid chunk");
         return m_chunk_columns.at({ chunk_pos.x, chunk_pos.y }).chunk_data_at(chunk_pos);
     }
 
+    // Allocates the section if the column does not have it yet
     ChunkData& chunk_data_at(nnm::Vector3i chunk_pos)
     {
         VV_DEB_ASSERT(m_chunk_columns.contains({ chunk_pos.x, chunk_pos.y }), "[WorldData] Invalid chunk");
         return m_chunk_columns.at({ chunk_pos.x, chunk_pos.y }).chunk_data_at(chunk_pos);
     }
 
+    // Whether the section is allocated, columns that are loaded report missing sections as open sky
     [[nodiscard]] bool contains_chunk(nnm::Vector3i chunk_pos) const
     {
-        return chunk_pos.z >= -10 && chunk_pos.z < 10 && m_chunk_columns.contains({ chunk_pos.x, chunk_pos.y });
+        const ChunkColumn* column = m_chunk_columns.find({ chunk_pos.x, chunk_pos.y });
+        return column != nullptr && column->contains_chunk_data(chunk_pos.z);
+    }
+
+    // Every column from min to max inclusive, see the class comment for who locks what
+    [[nodiscard]] ColumnLock lock_columns(const nnm::Vector2i min, const nnm::Vector2i max, const LockMode mode) const
+    {
+        return { *this, min, max, mode };
     }
 
+    // Unloaded columns read as air without light, missing sections of loaded columns as open sky
+    void copy_neighborhood(nnm::Vector3i chunk_pos, ChunkNeighborhood& neighborhood) const;
+
+    static void copy_neighborhood(const NeighborhoodSnapshot& snapshot, ChunkNeighborhood& neighborhood);
+
+    // Only holds the column locks while taking the section snapshots, the copy can then be made on any thread
+    [[nodiscard]] NeighborhoodSnapshot snapshot_neighborhood(nnm::Vector3i chunk_pos) const;
+
+    // Versions of the sections copy_neighborhood would read, equal signatures mean equal snapshots
+    [[nodiscard]] std::array<uint64_t, 27> neighborhood_versions(nnm::Vector3i chunk_pos) const;
+
+    // Measures the column again after it changed without being queued for saving, such as by relighting. Does nothing
+    // if it is not loaded.
+    void update_memory_usage(nnm::Vector2i chunk_pos);
+
     [[nodiscard]] bool contains_column(const nnm::Vector2i col_pos) const
     {
         return m_chunk_columns.contains(col_pos);
@@ -134,35 +215,148 @@ public:
 
     bool try_load_chunk_column_from_save(nnm::Vector2i chunk_pos);
 
+    // Loads every saved column from min to max inclusive that is not resident yet in one pass over the save, for
+    // warming up a whole area at once. Returns how many were loaded.
+    int load_region(nnm::Vector2i min, nnm::Vector2i max);
+
+    // Starts reading and decoding the columns on a background thread, soonest needed first, replacing what was asked
+    // for before. Columns that are already loaded, or are cheaper to load on the main thread, are skipped.
+    void prefetch_columns(const std::vector<nnm::Vector2i>& positions);
+
+    // Whether create_or_load_chunk would find the column without reading the save or generating it
+    [[nodiscard]] bool is_column_ready(const nnm::Vector2i col_pos) const
+    {
+        return m_residency.contains(col_pos) || m_column_prefetcher.is_ready(col_pos);
+    }
+
     void queue_save_chunk(nnm::Vector2i pos);
 
     void set_player_chunk(nnm::Vector2i chunk_pos);
 
+    // Takes the farthest column past the distance out of view and returns it. It stays resident, least recently
+    // viewed first in line for eviction once resident columns outgrow the memory budget, until create_or_load_chunk
+    // brings it back into view. Columns still in view twice the distance away can be evicted without being culled, see
+    // evict_occupant.
     std::optional<nnm::Vector2i> try_cull_chunk(float distance);
 
+    void set_memory_budget(const size_t bytes)
+    {
+        m_memory_budget = bytes;
+    }
+
+    [[nodiscard]] size_t memory_budget() const
+    {
+        return m_memory_budget;
+    }
+
+    void set_cache_budget(const size_t bytes)
+    {
+        m_column_cache.set_budget(bytes);
+    }
+
+    [[nodiscard]] size_t cache_budget() const
+    {
+        return m_column_cache.budget();
+    }
+
+    [[nodiscard]] size_t cache_memory_usage() const
+    {
+        return m_column_cache.memory_usage();
+    }
+
+    // Estimated bytes held by resident columns, re-measured when they are created, loaded, saved or culled
+    [[nodiscard]] size_t memory_usage() const
+    {
+        return m_memory_usage;
+    }
+
     [[nodiscard]] size_t chunk_count() const
     {
         return m_chunk_columns.size();
     }
 
 private:
+    static constexpr int sc_column_lock_shards = 64;
+    static constexpr size_t sc_default_memory_budget = size_t { 512 } * 1024 * 1024;
+    static constexpr BS::concurrency_t sc_relight_threads = 2;
+    // Picked at compile time (see VV_SAVE_BACKEND in CMakeLists.txt), saves are not converted between backends
+#if defined(VV_SAVE_BACKEND_REGION)
+    static constexpr SaveBackendType sc_save_backend = SaveBackendType::region;
+#else
+    static constexpr SaveBackendType sc_save_backend = SaveBackendType::leveldb;
+#endif
+
+    struct ColumnResidency {
+        size_t memory_usage = 0;
+        // Position in m_culled_columns while out of view
+        std::optional<std::list<nnm::Vector2i>::iterator> culled {};
+    };
+
+    // Columns within 8 of each other on both axes never share a shard
+    static int column_lock_shard(const nnm::Vector2i col_pos)
+    {
+        return (col_pos.x & 7) | (col_pos.y & 7) << 3;
+    }
+
+    [[nodiscard]] ColumnLock lock_column(const nnm::Vector2i col_pos) const
+    {
+        return { *this, col_pos, col_pos, LockMode::write };
+    }
+
+    // For creating and removing columns
+    std::unique_lock<std::shared_mutex> lock_index();
+
     void create_chunk_column(nnm::Vector2i chunk_pos);
 
+    // Moves a column read from the save or the cache in and brings it into view, queueing the sections at the heights
+    // to be saved, see load_column
+    void add_loaded_column(ChunkColumn column, const std::vector<int>& unsaved_heights = {});
+
     void process_save_queue();
 
     void remove_chunk_column(nnm::Vector2i chunk_pos);
 
-    void sort_chunks();
+    void add_residency(nnm::Vector2i chunk_pos);
+
+    // Makes room in the grid for a new column by evicting a culled one in its slot, or one in view left twice the cull
+    // distance behind
+    void evict_occupant(nnm::Vector2i chunk_pos);
+
+    void evict_to_budget();
+
+    // Versions as last written to or read from the save, of the column as a whole and of each section by height
+    struct SavedVersions {
+        // Empty if the save does not have the column as it is
+        std::optional<uint64_t> column;
+        std::unordered_map<int, uint64_t> sections;
+    };
 
     std::set<nnm::Vector2i> m_save_queue;
+    std::unordered_map<nnm::Vector2i, SavedVersions> m_saved_versions {};
     SaveFile m_save;
+    // Declared after the save so it finishes writing before the save closes
+    SaveWriter m_save_writer { m_save };
+    ColumnPrefetcher m_column_prefetcher { m_save };
+    // Relights columns loaded a region at a time, see load_region. Kept small, it idles otherwise and meshing has the
+    // cores.
+    BS::thread_pool m_relight_pool { sc_relight_threads };
     nnm::Vector2i m_player_chunk;
-    std::unordered_map<nnm::Vector2i, ChunkColumn> m_chunk_columns {};
-    std::vector<nnm::Vector2i> m_sorted_chunks {};
-
-    std::function<bool(nnm::Vector2i, nnm::Vector2i)> compare_from_player
-        = [&](const nnm::Vector2i a, const nnm::Vector2i b) {
-              return nnm::Vector2f(a).distance_sqrd(nnm::Vector2f(m_player_chunk))
-                  < nnm::Vector2f(b).distance_sqrd(nnm::Vector2f(m_player_chunk));
-          };
+    // Of the last try_cull_chunk, nothing in view is evicted before the first
+    float m_cull_distance = std::numeric_limits<float>::max();
+    // Declared before the columns so it outlives them, they return their sections on destruction
+    SectionPool m_section_pool {};
+    mutable std::mutex m_lock_turnstile {};
+    mutable std::shared_mutex m_index_mutex {};
+    mutable std::array<std::shared_mutex, sc_column_lock_shards> m_column_mutexes {};
+    ColumnGrid<ChunkColumn> m_chunk_columns {};
+    // Resident columns in view by distance from the player, for culling the farthest first
+    DistanceBuckets m_column_distances {};
+    ColumnGrid<ColumnResidency> m_residency {};
+    // Resident columns out of view, least recently viewed first
+    std::list<nnm::Vector2i> m_culled_columns {};
+    size_t m_memory_usage = 0;
+    size_t m_memory_budget = sc_default_memory_budget;
+    bool m_deferring_eviction = false;
+    // Evicted columns, checked before the save
+    ColumnCache m_column_cache {};
 };
\ No newline at end of file
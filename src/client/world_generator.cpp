@@ -2,6 +2,7 @@
 
 #include <FastNoiseLite.h>
 
+#include "block_accessor.hpp"
 #include "common.hpp"
 #include "lighting.hpp"
 #include "world_data.hpp"
@@ -26,12 +27,20 @@ void WorldGenerator::generate_chunk(WorldData& world_data, const nnm::Vector2i c
             return;
         }
     }
+    // Trees reach one column out from the columns they grow in. Also brings culled columns back into view so none
+    // of them are evicted while the others load.
+    for_2d({ -2, -2 }, { 3, 3 }, [&](const nnm::Vector2i offset) {
+        world_data.create_or_load_chunk(chunk_pos + offset);
+    });
+    const WorldData::ColumnLock lock = world_data.lock_columns(
+        { chunk_pos.x - 2, chunk_pos.y - 2 }, { chunk_pos.x + 2, chunk_pos.y + 2 }, WorldData::LockMode::write);
     for_2d({ -1, -1 }, { 2, 2 }, [&](const nnm::Vector2i offset) { generate_trees(world_data, chunk_pos + offset); });
     ChunkColumn& column = world_data.chunk_column_data_at(chunk_pos);
     apply_sunlight(column);
     // for (int h = -10; h < 10; ++h) {
     //     world_data.propagate_light({ chunk_pos.x, chunk_pos.y, h });
     // }
+    column.compact();
     column.set_gen_level(ChunkColumn::GenLevel::generated);
 }
 
@@ -60,7 +69,7 @@ void WorldGenerator::generate_terrain(ChunkColumn& data, nnm::Vector2i chunk_pos
         }
     }
 
-    for (int i = -10; i < 10; i++) {
+    for (int i = sc_min_height; i < sc_max_height; i++) {
         for_3d({ 0, 0, 0 }, { 16, 16, 16 }, [&](const nnm::Vector3i pos) {
             if (const nnm::Vector3i world_pos = block_local_to_world({ chunk_pos.x, chunk_pos.y, i }, pos);
                 static_cast<float>(world_pos.z) < heights[pos.x][pos.y] - 4) {
@@ -77,6 +86,7 @@ void WorldGenerator::generate_terrain(ChunkColumn& data, nnm::Vector2i chunk_pos
             }
         });
     }
+    data.compact();
     data.set_gen_level(ChunkColumn::GenLevel::terrain);
 }
 
@@ -84,9 +94,7 @@ void WorldGenerator::generate_trees(WorldData& world_data, nnm::Vector2i chunk_p
 {
     for_2d({ -1, -1 }, { 2, 2 }, [&](const nnm::Vector2i offset) {
         const nnm::Vector2i neighbor_pos = chunk_pos + offset;
-        if (!world_data.contains_column(neighbor_pos)) {
-            world_data.create_or_load_chunk(neighbor_pos);
-        }
+        VV_DEB_ASSERT(world_data.contains_column(neighbor_pos), "[WorldGenerator] Neighbor column not loaded")
         if (ChunkColumn& neighbor_column = world_data.chunk_column_data_at(neighbor_pos);
             neighbor_column.gen_level() < ChunkColumn::GenLevel::terrain) {
             generate_terrain(neighbor_column, neighbor_pos);
@@ -97,9 +105,11 @@ void WorldGenerator::generate_trees(WorldData& world_data, nnm::Vector2i chunk_p
         return;
     }
     std::array<std::array<int, 16>, 16> heights {};
+    // Reads finish before any tree is placed
+    BlockAccessor accessor(world_data);
     for_2d({ 0, 0 }, { 16, 16 }, [&](const nnm::Vector2i pos) {
-        for (int h = 9 * 16; h > -10 * 16; h--) {
-            if (column.get_block(nnm::Vector3i(chunk_pos.x * 16 + pos.x, chunk_pos.y * 16 + pos.y, h)) == 1) {
+        for (int h = column.max_height() * 16 - 1; h > column.min_height() * 16; h--) {
+            if (accessor.block_at(nnm::Vector3i(chunk_pos.x * 16 + pos.x, chunk_pos.y * 16 + pos.y, h)) == 1) {
                 heights[pos.x][pos.y] = h;
                 break;
             }
@@ -117,9 +127,6 @@ void WorldGenerator::generate_trees(WorldData& world_data, nnm::Vector2i chunk_p
             if (c_tree_struct[struct_pos.z][struct_pos.y][struct_pos.x] == 0) {
                 return;
             }
-            if (!is_block_height_world_valid(struct_pos.z + height + 1)) {
-                return;
-            }
             //            if (WorldData::is_block_pos_local_col(mve::Vector2i(pos.x + struct_pos.x - 2, pos.y +
             //            struct_pos.y - 2))) {
             //                int chunk_height = WorldData::chunk_height_from_block_height(std::floor(struct_pos.z +
@@ -132,7 +139,12 @@ void WorldGenerator::generate_trees(WorldData& world_data, nnm::Vector2i chunk_p
                 column.set_block(world_pos, c_tree_struct[struct_pos.z][struct_pos.y][struct_pos.x]);
             }
             else {
-                world_data.set_block(world_pos, c_tree_struct[struct_pos.z][struct_pos.y][struct_pos.x]);
+                // The caller holds the column locks, write through the column rather than the locking setter
+                const nnm::Vector3i neighbor_chunk_pos = chunk_pos_from_block_pos(world_pos);
+                const nnm::Vector2i neighbor_pos { neighbor_chunk_pos.x, neighbor_chunk_pos.y };
+                world_data.chunk_column_data_at(neighbor_pos)
+                    .set_block(world_pos, c_tree_struct[struct_pos.z][struct_pos.y][struct_pos.x]);
+                world_data.queue_save_chunk(neighbor_pos);
             }
 
             //            }
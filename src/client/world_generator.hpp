@@ -25,6 +25,10 @@ private:
 
     void generate_trees(WorldData& world_data, nnm::Vector2i chunk_pos) const;
 
+    // Section heights the terrain is generated between, the world itself has no vertical limit
+    static constexpr int sc_min_height = -10;
+    static constexpr int sc_max_height = 10;
+
     // clang-format off
     const uint8_t c_tree_struct[7][5][5]
         = { { { 0, 0, 0, 0, 0 },
@@ -4,12 +4,12 @@
 
 #include <nnm/nnm.hpp>
 
+#include "world_data.hpp"
+
 void WorldRenderer::push_mesh_update(nnm::Vector3i chunk_pos)
 {
-    if (m_chunk_mesh_lookup.contains(chunk_pos)) {
-        m_chunk_buffers.at(m_chunk_mesh_lookup.at(chunk_pos)).reset();
-    }
-    else {
+    // The current mesh stays in place until its replacement is built
+    if (!m_chunk_mesh_lookup.contains(chunk_pos)) {
         m_chunk_mesh_lookup.insert({ chunk_pos, m_chunk_buffers.size() });
         m_chunk_buffers.emplace_back();
     }
@@ -117,6 +117,8 @@ void WorldRenderer::remove_data(const nnm::Vector3i position)
 {
     m_chunk_buffers.at(m_chunk_mesh_lookup.at(position)).reset();
     m_chunk_mesh_lookup.erase(position);
+    m_chunk_mesh_versions.erase(position);
+    m_latest_mesh_ids.erase(position);
 }
 
 uint64_t WorldRenderer::create_debug_box(const BoundingBox& box, const float width, const nnm::Vector3f color)
@@ -159,24 +161,52 @@ void WorldRenderer::delete_all_debug_boxes()
 }
 void WorldRenderer::process_mesh_updates(const WorldData& world_data)
 {
+    // Updates whose inputs are unchanged since the mesh in place was built are dropped, which also drops duplicates
     std::erase_if(m_chunk_mesh_update_list, [&](const nnm::Vector3i& chunk_pos) {
-        return !m_chunk_mesh_lookup.contains(chunk_pos);
-    });
-    m_temp_chunk_buffer_data.clear();
-    m_temp_chunk_buffer_data.resize(m_chunk_mesh_update_list.size());
-    const BS::multi_future<void> tasks = m_thread_pool.submit_blocks<size_t>(
-        0, m_chunk_mesh_update_list.size(), [&](const auto begin, const auto end) {
-            for (auto i = begin; i < end; ++i) {
-                const nnm::Vector3i chunk_pos = m_chunk_mesh_update_list[i];
-                m_temp_chunk_buffer_data[i] = std::move(create_chunk_buffer_data(chunk_pos, world_data));
-            }
-        });
-    tasks.wait();
-    for (const std::optional<ChunkBufferData>& buffer_data : m_temp_chunk_buffer_data) {
-        if (buffer_data.has_value()) {
-            ChunkBuffers buffers(*m_renderer, buffer_data.value());
-            m_chunk_buffers[m_chunk_mesh_lookup[buffers.chunk_pos()]] = std::move(buffers);
+        if (!m_chunk_mesh_lookup.contains(chunk_pos)) {
+            return true;
         }
+        const std::array<uint64_t, 27> versions = world_data.neighborhood_versions(chunk_pos);
+        if (const auto it = m_chunk_mesh_versions.find(chunk_pos);
+            it != m_chunk_mesh_versions.end() && it->second == versions) {
+            return true;
+        }
+        m_chunk_mesh_versions[chunk_pos] = versions;
+        return false;
+    });
+    // Each mesh is built from the exact sections its versions were taken from, edits made meanwhile copy away from
+    // the snapshot rather than tearing it
+    for (const nnm::Vector3i chunk_pos : m_chunk_mesh_update_list) {
+        const uint64_t id = m_next_mesh_id++;
+        m_latest_mesh_ids[chunk_pos] = id;
+        m_pending_meshes.push_back(
+            { chunk_pos,
+              id,
+              m_thread_pool.submit_task([snapshot = world_data.snapshot_neighborhood(chunk_pos)] {
+                  thread_local ChunkNeighborhood neighborhood;
+                  WorldData::copy_neighborhood(snapshot, neighborhood);
+                  return create_chunk_buffer_data(neighborhood);
+              }) });
     }
     m_chunk_mesh_update_list.clear();
+    std::erase_if(m_pending_meshes, [&](PendingMesh& pending) {
+        if (pending.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return false;
+        }
+        const std::optional<ChunkBufferData> buffer_data = pending.result.get();
+        const auto latest = m_latest_mesh_ids.find(pending.chunk_pos);
+        if (latest == m_latest_mesh_ids.end() || latest->second != pending.id) {
+            return true;
+        }
+        m_latest_mesh_ids.erase(latest);
+        std::optional<ChunkBuffers>& buffers = m_chunk_buffers[m_chunk_mesh_lookup.at(pending.chunk_pos)];
+        if (buffer_data.has_value()) {
+            buffers = ChunkBuffers(*m_renderer, buffer_data.value());
+        }
+        else {
+            buffers.reset();
+        }
+        return true;
+    });
 }
+
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <future>
+#include <optional>
 #include <unordered_map>
 
 #include <BS_thread_pool.hpp>
@@ -9,6 +12,7 @@
 #include <nnm/nnm.hpp>
 
 #include "chunk_mesh.hpp"
+#include "chunk_neighborhood.hpp"
 #include "frustum.hpp"
 #include "player.hpp"
 #include "wire_box_mesh.hpp"
@@ -19,6 +23,7 @@ public:
 
     void push_mesh_update(nnm::Vector3i chunk_pos);
 
+    // Starts meshing the queued updates and uploads whichever earlier ones have finished, never waits on workers
     void process_mesh_updates(const WorldData& world_data);
 
     bool contains_data(nnm::Vector3i position) const;
@@ -74,6 +79,12 @@ private:
         WireBoxMesh mesh;
     };
 
+    struct PendingMesh {
+        nnm::Vector3i chunk_pos;
+        uint64_t id;
+        std::future<std::optional<ChunkBufferData>> result;
+    };
+
     // void rebuild_mesh_lookup();
 
     mve::Renderer* m_renderer;
@@ -88,11 +99,16 @@ private:
     mve::DescriptorSet m_chunk_descriptor_set;
     mve::UniformLocation m_view_location;
     mve::UniformLocation m_proj_location;
-    std::vector<std::optional<ChunkBufferData>> m_temp_chunk_buffer_data {};
     std::unordered_map<nnm::Vector3i, size_t> m_chunk_mesh_lookup {};
+    // Input versions each mesh was built from, see WorldData::neighborhood_versions
+    std::unordered_map<nnm::Vector3i, std::array<uint64_t, 27>> m_chunk_mesh_versions {};
     std::vector<std::optional<ChunkBuffers>> m_chunk_buffers {};
     Frustum m_frustum;
     SelectionBox m_selection_box;
     std::unordered_map<uint64_t, DebugBox> m_debug_boxes {};
     std::vector<nnm::Vector3i> m_chunk_mesh_update_list {};
+    std::vector<PendingMesh> m_pending_meshes {};
+    // Only the most recently submitted mesh of a section is uploaded, older ones finishing later are dropped
+    std::unordered_map<nnm::Vector3i, uint64_t> m_latest_mesh_ids {};
+    uint64_t m_next_mesh_id = 0;
 };
\ No newline at end of file